@@ -0,0 +1,264 @@
+// ==============================================
+// Animation
+// ==============================================
+
+// How one frame of a clip differs from standing still. Forward is in the
+// direction the actor is facing.
+struct Pose {
+    i32  forward;
+    i32  bob;
+    i32  left_leg_lift;
+    i32  right_leg_lift;
+    bool claws;
+    f32  duration;
+};
+
+// Clips that don't loop fall back to idle, facing the same way.
+struct ClipPoses {
+           u32  count;
+           bool loops;
+    struct Pose poses[2];
+};
+
+static struct ClipPoses clip_poses[ActionCount] = {
+    [ActionIdle] = {
+        .count = 2,
+        .loops = true,
+        .poses = {
+            { .duration = 0.5f },
+            { .duration = 0.5f, .bob = 1 },
+        },
+    },
+    [ActionWalk] = {
+        .count = 2,
+        .poses = {
+            { .duration = 0.06f, .left_leg_lift  = 3 },
+            { .duration = 0.06f, .right_leg_lift = 3 },
+        },
+    },
+    [ActionAttack] = {
+        .count = 2,
+        .poses = {
+            { .duration = 0.08f, .forward = -2 },
+            { .duration = 0.12f, .forward =  3, .claws = true },
+        },
+    },
+};
+
+static i32 facing_x[FacingCount] = { [FacingLeft] = -1, [FacingRight] = 1 };
+static i32 facing_y[FacingCount] = { [FacingUp]   = -1, [FacingDown]  = 1 };
+
+enum Facing FacingFromDirection(i32 x, i32 y) {
+    return(x < 0 ? FacingLeft
+         : x > 0 ? FacingRight
+         : y < 0 ? FacingUp
+         :         FacingDown);
+}
+
+// ==============================================
+// Baking
+
+// Coordinates are relative to the frame, anything outside it is dropped.
+void FillAtlasRect(struct SpriteAtlas* atlas, struct Rect frame, i32 x, i32 y, i32 w, i32 h, u8 index) {
+    i32 min_x = Max(x,     0);
+    i32 min_y = Max(y,     0);
+    i32 max_x = Min(x + w, frame.w);
+    i32 max_y = Min(y + h, frame.h);
+
+    for (i32 row = min_y; row < max_y; row += 1) {
+        u8* pixels = atlas->pixels + (frame.y + row) * atlas->pitch + frame.x;
+
+        for (i32 column = min_x; column < max_x; column += 1) {
+            pixels[column] = index;
+        }
+    }
+}
+
+// The body is drawn in ATLAS_BODY so the game can colour each actor itself, only
+// the details are baked in.
+void DrawFrame(struct SpriteAtlas* atlas, struct Rect frame, enum AnimationSet set, enum Facing facing, struct Pose* pose) {
+    i32 x = pose->forward * facing_x[facing];
+    i32 y = pose->forward * facing_y[facing] + pose->bob;
+
+    // Body with its corners knocked off, then legs.
+    FillAtlasRect(atlas, frame, x + 7,  y + 6,  18, 18, ATLAS_BODY);
+    FillAtlasRect(atlas, frame, x + 7,  y + 6,  1,  1,  ATLAS_TRANSPARENT);
+    FillAtlasRect(atlas, frame, x + 24, y + 6,  1,  1,  ATLAS_TRANSPARENT);
+    FillAtlasRect(atlas, frame, x + 7,  y + 23, 1,  1,  ATLAS_TRANSPARENT);
+    FillAtlasRect(atlas, frame, x + 24, y + 23, 1,  1,  ATLAS_TRANSPARENT);
+    FillAtlasRect(atlas, frame, x + 9,  y + 24, 5,  6 - pose->left_leg_lift,  ATLAS_BODY);
+    FillAtlasRect(atlas, frame, x + 18, y + 24, 5,  6 - pose->right_leg_lift, ATLAS_BODY);
+
+    if (set == AnimationDemon) {
+        FillAtlasRect(atlas, frame, x + 7,  y + 2, 2, 4, ATLAS_BODY);
+        FillAtlasRect(atlas, frame, x + 23, y + 2, 2, 4, ATLAS_BODY);
+    }
+
+    // Eyes, there are none to see from behind.
+    switch (facing) {
+        case FacingDown: {
+            FillAtlasRect(atlas, frame, x + 11, y + 10, 3, 3, ColourWhite);
+            FillAtlasRect(atlas, frame, x + 18, y + 10, 3, 3, ColourWhite);
+            FillAtlasRect(atlas, frame, x + 12, y + 11, 1, 1, ColourBlack);
+            FillAtlasRect(atlas, frame, x + 19, y + 11, 1, 1, ColourBlack);
+        } break;
+
+        case FacingLeft: {
+            FillAtlasRect(atlas, frame, x + 8,  y + 10, 3, 3, ColourWhite);
+            FillAtlasRect(atlas, frame, x + 8,  y + 11, 1, 1, ColourBlack);
+        } break;
+
+        case FacingRight: {
+            FillAtlasRect(atlas, frame, x + 21, y + 10, 3, 3, ColourWhite);
+            FillAtlasRect(atlas, frame, x + 23, y + 11, 1, 1, ColourBlack);
+        } break;
+
+        default: break;
+    }
+
+    // Three scratches just past the front of the body.
+    if (pose->claws) {
+        i32 across_x = -facing_y[facing];
+        i32 across_y =  facing_x[facing];
+
+        for (i32 claw = -1; claw <= 1; claw += 1) {
+            for (i32 step = 0; step < 3; step += 1) {
+                i32 claw_x = 16 + facing_x[facing] * (11 + step) + across_x * claw * 5;
+                i32 claw_y = 15 + facing_y[facing] * (11 + step) + across_y * claw * 5;
+
+                FillAtlasRect(atlas, frame, x + claw_x, y + claw_y, 1, 1, ColourWhite);
+            }
+        }
+    }
+}
+
+// Draws every clip into the atlas, one row per set and facing, and fills in the
+// frame table to match.
+void BakeAnimations(struct FrameTable* table, struct SpriteAtlas* atlas, struct MemoryArena* arena) {
+    u32 frames_per_row = 0;
+
+    for (u32 action = 0; action < ActionCount; action += 1) {
+        frames_per_row += clip_poses[action].count;
+    }
+
+    u32 rows = AnimationSetCount * FacingCount;
+
+    InitSpriteAtlas(atlas, frames_per_row * ANIMATION_FRAME_SIZE, rows * ANIMATION_FRAME_SIZE, arena);
+
+    table->count    = 0;
+    table->source   = PushArray(arena, struct Rect, frames_per_row * rows);
+    table->duration = PushArray(arena, f32,         frames_per_row * rows);
+    table->next     = PushArray(arena, u16,         frames_per_row * rows);
+
+    for (u32 set = 0; set < AnimationSetCount; set += 1) {
+        for (u32 facing = 0; facing < FacingCount; facing += 1) {
+            i32 row = set * FacingCount + facing;
+            i32 column = 0;
+
+            // Idle is baked first so the other clips can fall back to it.
+            for (u32 action = 0; action < ActionCount; action += 1) {
+                struct ClipPoses* clip  = &clip_poses[action];
+                u16               first = (u16)table->count;
+
+                table->clip_first[set][action][facing] = first;
+
+                for (u32 i = 0; i < clip->count; i += 1) {
+                    u32 frame = table->count++;
+
+                    table->source[frame] = (struct Rect){
+                        column * ANIMATION_FRAME_SIZE,
+                        row    * ANIMATION_FRAME_SIZE,
+                        ANIMATION_FRAME_SIZE,
+                        ANIMATION_FRAME_SIZE,
+                    };
+
+                    table->duration[frame] = clip->poses[i].duration;
+                    table->next[frame]     = (i + 1 < clip->count) ? (u16)(frame + 1)
+                                           : clip->loops           ? first
+                                           :                         table->clip_first[set][ActionIdle][facing];
+
+                    DrawFrame(atlas, table->source[frame], set, facing, &clip->poses[i]);
+
+                    column += 1;
+                }
+            }
+        }
+    }
+}
+
+// ==============================================
+// Animators
+
+void InitAnimators(struct Animators* animators, u32 capacity, struct MemoryArena* arena) {
+    Assert((capacity & 3) == 0);
+
+    animators->count     = 0;
+    animators->capacity  = capacity;
+    animators->frame     = PushArray(arena, u16, capacity);
+    animators->time_left = PushArray(arena, f32, capacity);
+
+    // Unused slots still get stepped along with their neighbours, they just
+    // never run out.
+    for (u32 i = 0; i < capacity; i += 1) {
+        animators->frame    [i] = 0;
+        animators->time_left[i] = 1e30f;
+    }
+}
+
+void PlayAnimation(
+    struct Animators*    animators,
+    struct FrameTable*   table,
+    u32                  animator,
+    enum AnimationSet    set,
+    enum AnimationAction action,
+    enum Facing          facing
+) {
+    u16 frame = table->clip_first[set][action][facing];
+
+    animators->frame    [animator] = frame;
+    animators->time_left[animator] = table->duration[frame];
+}
+
+u32 AddAnimator(struct Animators* animators, struct FrameTable* table, enum AnimationSet set, enum Facing facing) {
+    Assert(animators->count < animators->capacity);
+
+    u32 animator = animators->count++;
+    PlayAnimation(animators, table, animator, set, ActionIdle, facing);
+
+    return(animator);
+}
+
+// Only animators whose frame ran out this step touch the frame table, a whole
+// group of 4 that is still mid frame is skipped with one compare.
+void UpdateAnimators(struct Animators* animators, struct FrameTable* table, f32 seconds) {
+    __m128 elapsed = _mm_set1_ps(seconds);
+    __m128 zero    = _mm_setzero_ps();
+
+    u32 padded_count = (animators->count + 3) & ~3;
+
+    for (u32 i = 0; i < padded_count; i += 4) {
+        __m128 time_left = _mm_sub_ps(_mm_load_ps(animators->time_left + i), elapsed);
+        _mm_store_ps(animators->time_left + i, time_left);
+
+        i32 expired = _mm_movemask_ps(_mm_cmple_ps(time_left, zero));
+
+        if (expired) {
+            for (u32 lane = 0; lane < 4; lane += 1) {
+                if (expired & (1 << lane)) {
+                    u32 index = i + lane;
+                    u16 frame = animators->frame[index];
+                    f32 left  = animators->time_left[index];
+
+                    // A long step can run through more than one frame.
+                    while (left <= 0.0f) {
+                        frame = table->next[frame];
+                        left += table->duration[frame];
+                    }
+
+                    animators->frame    [index] = frame;
+                    animators->time_left[index] = left;
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,54 @@
+// ==============================================
+// Animation
+// ==============================================
+
+enum Facing {
+    FacingDown,
+    FacingLeft,
+    FacingRight,
+    FacingUp,
+
+    FacingCount,
+};
+
+enum AnimationAction {
+    ActionIdle,
+    ActionWalk,
+    ActionAttack,
+
+    ActionCount,
+};
+
+enum AnimationSet {
+    AnimationPlayer,
+    AnimationDemon,
+
+    AnimationSetCount,
+};
+
+#define ANIMATION_FRAME_SIZE 32
+
+// Passed as the atlas field of the sort key, so actors batch together.
+#define ACTOR_ATLAS_ID 1
+
+// Every frame of every clip, baked into flat arrays up front. A clip is a run of
+// frames starting at `clip_first`, and each frame names the one that follows it,
+// so looping and falling back to idle are just where `next` points.
+struct FrameTable {
+           u32   count;
+    struct Rect* source;   // Where the frame is in the atlas.
+           f32*  duration; // Seconds.
+           u16*  next;
+
+           u16   clip_first[AnimationSetCount][ActionCount][FacingCount];
+};
+
+// Stored as a structure of arrays so the update can step 4 timers at once, it
+// only looks at the frame table for the animators whose frame has run out.
+// Capacity is kept a multiple of 4 so the update never needs a scalar tail.
+struct Animators {
+    u32  count;
+    u32  capacity;
+    u16* frame;
+    f32* time_left;
+};
@@ -0,0 +1,37 @@
+// ==============================================
+// Memory Arenas
+// ==============================================
+
+// A linear allocator carved out of one of the blocks in `struct Memory`.
+// Nothing is freed individually, the whole arena is reset at once.
+struct MemoryArena {
+    u8* base;
+    u64 size;
+    u64 used;
+};
+
+#define PushStruct(arena, type)       (type*)PushSize(arena, sizeof(type), 16)
+#define PushArray(arena, type, count) (type*)PushSize(arena, (u64)(count) * sizeof(type), 16)
+
+void InitArena(struct MemoryArena* arena, void* base, u64 size) {
+    arena->base = (u8*)base;
+    arena->size = size;
+    arena->used = 0;
+}
+
+// Alignment must be a power of two.
+void* PushSize(struct MemoryArena* arena, u64 size, u64 alignment) {
+    u64 address = (u64)(arena->base + arena->used);
+    u64 padding = (alignment - (address & (alignment - 1))) & (alignment - 1);
+
+    Assert(arena->used + padding + size <= arena->size);
+
+    void* result = arena->base + arena->used + padding;
+    arena->used += padding + size;
+
+    return(result);
+}
+
+void ResetArena(struct MemoryArena* arena) {
+    arena->used = 0;
+}
@@ -0,0 +1,702 @@
+// ==============================================
+// Audio
+// ==============================================
+
+void InitMixer(struct Mixer* mixer, u32 samples_per_second, struct MemoryArena* arena) {
+    memset(mixer->voices, 0, sizeof(mixer->voices));
+
+    mixer->samples_per_second = samples_per_second;
+    mixer->master_volume      = 1.0f;
+    mixer->frames_mixed       = 0;
+    mixer->listener_x         = 0.0f;
+    mixer->listener_y         = 0.0f;
+    mixer->listener_sight     = NULL;
+    mixer->random_state       = 0x5EED;
+    mixer->synth              = NULL;
+    mixer->music              = NULL;
+
+    for (u32 i = 0; i < SoundEventCount; i += 1) {
+        mixer->last_variation[i] = 0xFFFFFFFF;
+        mixer->event_full_at [i] = 0xFFFFFFFFFFFFFFFF;
+    }
+
+    mixer->muffle = (struct LowPass){};
+    SetLowPass(&mixer->muffle, MUFFLED_CUTOFF, samples_per_second);
+    InitReverb(&mixer->room, samples_per_second, arena);
+
+    mixer->buses[MixBusMaster]  = (struct MixBus){ .output = MixBusMaster };
+    mixer->buses[MixBusWorld]   = (struct MixBus){ .output = MixBusMaster, .reverb   = &mixer->room   };
+    mixer->buses[MixBusMuffled] = (struct MixBus){ .output = MixBusWorld,  .low_pass = &mixer->muffle };
+
+    mixer->effects_budget_milliseconds = 0.0f;
+    mixer->effects_milliseconds        = 0.0f;
+}
+
+// ==============================================
+// Loading
+
+static char* sound_asset_files[SoundAssetCount] = {
+    [SoundHit0]     = "data/audio/hit_0.wav",
+    [SoundHit1]     = "data/audio/hit_1.wav",
+    [SoundHit3]     = "data/audio/hit_3.wav",
+    [SoundLoss0]    = "data/audio/loss_0.wav",
+    [SoundLoss1]    = "data/audio/loss_1.wav",
+    [SoundLoss2]    = "data/audio/loss_2.wav",
+    [SoundPickup0]  = "data/audio/pickup_0.wav",
+    [SoundPickup1]  = "data/audio/pickup_1.wav",
+    [SoundPickup2]  = "data/audio/pickup_2.wav",
+    [SoundPowerup0] = "data/audio/powerup_0.wav",
+    [SoundPowerup1] = "data/audio/powerup_1.wav",
+    [SoundPowerup2] = "data/audio/powerup_2.wav",
+};
+
+// WAV files are little endian whatever they were written on.
+u32 ReadU16(u8* data) {
+    return((u32)data[0] | ((u32)data[1] << 8));
+}
+
+u32 ReadU32(u8* data) {
+    return((u32)data[0] | ((u32)data[1] << 8) | ((u32)data[2] << 16) | ((u32)data[3] << 24));
+}
+
+// Walks the chunks of a RIFF file for the format and the samples, skipping
+// anything else. Only uncompressed 8 and 16 bit PCM is understood.
+bool ParseWav(struct DebugFile file, struct WavFormat* format) {
+    u8*  data         = file.data;
+    u64  size         = file.size;
+    bool valid        = size >= 12 && memcmp(data, "RIFF", 4) == 0 && memcmp(data + 8, "WAVE", 4) == 0;
+    bool found_format = false;
+    bool found_data   = false;
+    u32  block_align  = 0;
+    u64  offset       = 12;
+
+    while (valid && !found_data && offset + 8 <= size) {
+        u8* chunk      = data + offset;
+        u64 chunk_size = ReadU32(chunk + 4);
+        u64 available  = size - offset - 8;
+
+        if (memcmp(chunk, "fmt ", 4) == 0) {
+            valid = chunk_size >= 16 && chunk_size <= available;
+
+            if (valid) {
+                u32 encoding = ReadU16(chunk + 8);
+
+                format->channel_count      = ReadU16(chunk + 10);
+                format->samples_per_second = ReadU32(chunk + 12);
+                format->bits_per_sample    = ReadU16(chunk + 22);
+                block_align                = ReadU16(chunk + 20);
+
+                valid = encoding == 1
+                     && (format->channel_count == 1 || format->channel_count == 2)
+                     && (format->bits_per_sample == 8 || format->bits_per_sample == 16)
+                     && format->samples_per_second > 0
+                     && block_align == format->channel_count * format->bits_per_sample / 8;
+
+                found_format = valid;
+            }
+        } else if (memcmp(chunk, "data", 4) == 0) {
+            // Some writers get the size wrong when they stop early, so the
+            // file is trusted over the header.
+            valid = found_format;
+
+            if (valid) {
+                format->frame_count = (u32)(Min(chunk_size, available) / block_align);
+                format->data        = chunk + 8;
+
+                found_data = true;
+            }
+        }
+
+        // Chunks are padded to an even size.
+        offset += 8 + chunk_size + (chunk_size & 1);
+    }
+
+    return(valid && found_data && format->frame_count > 0);
+}
+
+i16 WavSample(struct WavFormat* format, u32 index) {
+    return((format->bits_per_sample == 8)
+         ? (i16)(((i32)format->data[index] - 128) << 8)
+         : (i16)ReadU16(format->data + index * 2));
+}
+
+// Everything is converted to 16 bit once here, so the mixer only ever deals
+// with one format. Files recorded at another rate are resampled with a
+// straight line between frames.
+void ConvertWav(struct WavFormat* format, struct Sound* sound, u32 samples_per_second, struct MemoryArena* arena) {
+    u32 channels = format->channel_count;
+    u64 step     = ((u64)format->samples_per_second << VOICE_FRACTION_BITS) / samples_per_second;
+
+    sound->channel_count      = channels;
+    sound->samples_per_second = samples_per_second;
+    sound->frame_count        = (u32)(((u64)format->frame_count * samples_per_second) / format->samples_per_second);
+    sound->frame_count        = Max(sound->frame_count, 1);
+    sound->samples            = PushArray(arena, i16, (sound->frame_count + 1) * channels);
+
+    u64 position = 0;
+
+    for (u32 frame = 0; frame < sound->frame_count; frame += 1) {
+        u32 from = Min((u32)(position >> VOICE_FRACTION_BITS), format->frame_count - 1);
+        u32 to   = Min(from + 1, format->frame_count - 1);
+        f32 t    = (f32)(position & 0xFFFFFFFF) / (f32)(1ULL << VOICE_FRACTION_BITS);
+
+        for (u32 channel = 0; channel < channels; channel += 1) {
+            f32 a = WavSample(format, from * channels + channel);
+            f32 b = WavSample(format, to   * channels + channel);
+
+            sound->samples[frame * channels + channel] = (i16)(a + (b - a) * t);
+        }
+
+        position += step;
+    }
+
+    // The guard frame, see struct Sound.
+    for (u32 channel = 0; channel < channels; channel += 1) {
+        sound->samples[sound->frame_count * channels + channel] = sound->samples[channel];
+    }
+}
+
+// A sound that fails to load is left empty, and never plays.
+bool LoadSound(struct Sound* sound, char* filename, u32 samples_per_second, struct MemoryArena* arena) {
+    struct DebugFile file   = DebugOpenFile(filename);
+    struct WavFormat format = {};
+           bool      loaded = ParseWav(file, &format);
+
+    if (loaded) {
+        ConvertWav(&format, sound, samples_per_second, arena);
+    } else {
+        *sound = (struct Sound){};
+    }
+
+    DebugCloseFile(file);
+
+    return(loaded);
+}
+
+void LoadSoundAssets(struct Sound* sounds, u32 samples_per_second, struct MemoryArena* arena) {
+    for (u32 i = 0; i < SoundAssetCount; i += 1) {
+        LoadSound(&sounds[i], sound_asset_files[i], samples_per_second, arena);
+    }
+}
+
+// ==============================================
+// Voices
+
+void UpdateVoiceGains(struct Voice* voice) {
+    ConstantPowerPan(voice->volume * voice->attenuation, voice->pan, &voice->gain_left, &voice->gain_right);
+}
+
+// Fades out over the hearing range, slowly at first, so sounds nearby are all
+// about as loud and the fade into the culling distance is gentle.
+f32 DistanceAttenuation(struct Mixer* mixer, f32 x, f32 y) {
+    f32 distance_x = x - mixer->listener_x;
+    f32 distance_y = y - mixer->listener_y;
+    f32 distance   = sqrtf(distance_x * distance_x + distance_y * distance_y);
+    f32 t          = Max(1.0f - distance / HEARING_RANGE_TILES, 0.0f);
+
+    return(t * t);
+}
+
+void PlaceVoice(struct Mixer* mixer, struct Voice* voice) {
+    struct Visibility* sight     = mixer->listener_sight;
+           bool        is_hidden = sight && !CanSee(sight, (i32)floorf(voice->x), (i32)floorf(voice->y));
+
+    voice->attenuation = DistanceAttenuation(mixer, voice->x, voice->y);
+    voice->pan         = Clamp((voice->x - mixer->listener_x) / FULL_PAN_TILES, -1.0f, 1.0f);
+    voice->bus         = is_hidden ? MixBusMuffled : MixBusWorld;
+
+    UpdateVoiceGains(voice);
+}
+
+// How far through the sound to move for each frame mixed, which also takes
+// care of sounds recorded at a different rate to the mixer.
+u64 VoiceStep(struct Mixer* mixer, struct Sound* sound, f32 pitch) {
+    f64 rate = (f64)Max(pitch, 0.01f) * (f64)sound->samples_per_second / (f64)mixer->samples_per_second;
+    return((u64)(rate * (f64)(1ULL << VOICE_FRACTION_BITS)));
+}
+
+struct Voice* GetVoice(struct Mixer* mixer, VoiceId id) {
+    struct Voice* voice = &mixer->voices[id & (MAX_VOICES - 1)];
+    bool is_current     = voice->sound != NULL && voice->generation == (id >> VOICE_INDEX_BITS);
+
+    return(is_current ? voice : NULL);
+}
+
+VoiceId StartVoice(
+    struct Mixer* mixer,
+           u32    index,
+    struct Sound* sound,
+           f32    volume,
+           f32    pan,
+           f32    pitch,
+           bool   looping,
+           u32    event
+) {
+    struct Voice* voice      = &mixer->voices[index];
+           u32    generation = (voice->generation + 1) & ((1 << (32 - VOICE_INDEX_BITS)) - 1);
+
+    *voice = (struct Voice){
+        .sound       = sound,
+        .position    = 0,
+        .step        = VoiceStep(mixer, sound, pitch),
+        .volume      = volume,
+        .pan         = pan,
+        .pitch       = pitch,
+        .looping     = looping,
+        .attenuation = 1.0f,
+        .generation  = Max(generation, 1),
+        .event       = event,
+        .start_frame = mixer->frames_mixed,
+        .bus         = MixBusWorld,
+    };
+
+    UpdateVoiceGains(voice);
+
+    return((voice->generation << VOICE_INDEX_BITS) | index);
+}
+
+// Returns 0 when every voice is already playing, or the sound is empty.
+VoiceId PlaySound(struct Mixer* mixer, struct Sound* sound, f32 volume, f32 pan, f32 pitch, bool looping) {
+    VoiceId id = 0;
+
+    for (u32 i = 0; i < MAX_VOICES && id == 0 && sound->frame_count > 0; i += 1) {
+        if (mixer->voices[i].sound == NULL) {
+            id = StartVoice(mixer, i, sound, volume, pan, pitch, looping, SoundEventNone);
+        }
+    }
+
+    return(id);
+}
+
+void StopVoice(struct Mixer* mixer, VoiceId id) {
+    struct Voice* voice = GetVoice(mixer, id);
+
+    if (voice) {
+        voice->sound = NULL;
+
+        if (voice->event != SoundEventNone) {
+            mixer->event_full_at[voice->event] = 0xFFFFFFFFFFFFFFFF;
+        }
+    }
+}
+
+void SetVoiceVolume(struct Mixer* mixer, VoiceId id, f32 volume, f32 pan) {
+    struct Voice* voice = GetVoice(mixer, id);
+
+    if (voice) {
+        voice->volume = volume;
+        voice->pan    = pan;
+        UpdateVoiceGains(voice);
+    }
+}
+
+// Moves a voice somewhere on the tile map. From then on it is panned and
+// attenuated from the listener, and its own pan is ignored.
+void SetVoicePosition(struct Mixer* mixer, VoiceId id, f32 x, f32 y) {
+    struct Voice* voice = GetVoice(mixer, id);
+
+    if (voice) {
+        voice->positioned = true;
+        voice->x          = x;
+        voice->y          = y;
+        PlaceVoice(mixer, voice);
+    }
+}
+
+// Positioned voices follow the listener from the next mix on. The sight can be
+// NULL, for a listener that hears everything clearly.
+void SetListener(struct Mixer* mixer, f32 x, f32 y, struct Visibility* sight) {
+    mixer->listener_x     = x;
+    mixer->listener_y     = y;
+    mixer->listener_sight = sight;
+}
+
+void SetVoicePitch(struct Mixer* mixer, VoiceId id, f32 pitch) {
+    struct Voice* voice = GetVoice(mixer, id);
+
+    if (voice) {
+        voice->pitch = pitch;
+        voice->step  = VoiceStep(mixer, voice->sound, pitch);
+    }
+}
+
+// ==============================================
+// Events
+
+// Variations are runs of consecutive assets. The hits are recorded at full
+// scale, so at the attack's volume a third one on top of two would clip.
+static struct SoundEventInfo sound_events[SoundEventCount] = {
+    [SoundEventHit]     = { .first_variation = SoundHit0,     .variation_count = 3, .max_instances = 2 },
+    [SoundEventLoss]    = { .first_variation = SoundLoss0,    .variation_count = 3, .max_instances = 2 },
+    [SoundEventPickup]  = { .first_variation = SoundPickup0,  .variation_count = 3, .max_instances = 3 },
+    [SoundEventPowerup] = { .first_variation = SoundPowerup0, .variation_count = 3, .max_instances = 2 },
+};
+
+// Whether `a` should be stolen before `b`: quieter first, counting how far off
+// they are, then older.
+bool IsBetterToSteal(struct Voice* a, struct Voice* b) {
+    f32 a_volume = a->volume * a->attenuation;
+    f32 b_volume = b->volume * b->attenuation;
+
+    return(a_volume < b_volume || (a_volume == b_volume && a->start_frame < b->start_frame));
+}
+
+// Plays one of the event's variations. Once the event has as many voices as it
+// is allowed, the quietest or oldest of them is cut off for the new one, so a
+// crowd all doing the same thing costs no more than a few of them would and
+// doesn't pile up into clipping. With every voice busy, the quietest or oldest
+// voice of all goes instead.
+//
+// Events happen somewhere on the tile map, and those too far from the listener
+// to hear don't take a voice at all.
+//
+// Returns 0 when the event is out of earshot, or its voices are all too new to
+// cut off.
+VoiceId PlaySoundEvent(struct Mixer* mixer, struct Sound* sounds, enum SoundEvent event, f32 volume, f32 x, f32 y) {
+    struct SoundEventInfo* info = &sound_events[event];
+
+    VoiceId id = 0;
+
+    if (DistanceAttenuation(mixer, x, y) > 0.0f && mixer->event_full_at[event] != mixer->frames_mixed) {
+        // One pass finds everything that might be needed.
+        u32 instances      = 0;
+        i32 free_voice     = -1;
+        i32 steal_instance = -1;
+        i32 steal_any      = -1;
+
+        for (u32 i = 0; i < MAX_VOICES; i += 1) {
+            struct Voice* voice = &mixer->voices[i];
+
+            if (voice->sound == NULL) {
+                free_voice = (free_voice < 0) ? (i32)i : free_voice;
+            } else {
+                if (voice->event == event) {
+                    instances += 1;
+
+                    if (steal_instance < 0 || IsBetterToSteal(voice, &mixer->voices[steal_instance])) {
+                        steal_instance = i;
+                    }
+                }
+
+                if (steal_any < 0 || IsBetterToSteal(voice, &mixer->voices[steal_any])) {
+                    steal_any = i;
+                }
+            }
+        }
+
+        u64 min_frames = (u64)(SOUND_EVENT_MIN_SECONDS * (f32)mixer->samples_per_second);
+
+        i32 index = (instances >= info->max_instances) ? steal_instance
+                  : (free_voice >= 0)                   ? free_voice
+                  :                                       steal_any;
+
+        if (instances >= info->max_instances && mixer->frames_mixed - mixer->voices[index].start_frame < min_frames) {
+            mixer->event_full_at[event] = mixer->frames_mixed;
+        } else {
+            u32 variation = NextRandom(&mixer->random_state) % info->variation_count;
+
+            if (variation == mixer->last_variation[event] && info->variation_count > 1) {
+                variation = (variation + 1) % info->variation_count;
+            }
+
+            mixer->last_variation[event] = variation;
+
+            struct Sound* sound = &sounds[info->first_variation + variation];
+
+            if (sound->frame_count > 0) {
+                id = StartVoice(mixer, index, sound, volume, 0.0f, 1.0f, false, event);
+                SetVoicePosition(mixer, id, x, y);
+            }
+        }
+    }
+
+    return(id);
+}
+
+// ==============================================
+// Mixing
+
+// Adds four stereo frames, as two pairs of left and right, into the
+// accumulator at `out`.
+void Accumulate4(f32* out, __m128 first, __m128 second, __m128 gains) {
+    _mm_storeu_ps(out + 0, _mm_add_ps(_mm_loadu_ps(out + 0), _mm_mul_ps(first,  gains)));
+    _mm_storeu_ps(out + 4, _mm_add_ps(_mm_loadu_ps(out + 4), _mm_mul_ps(second, gains)));
+}
+
+// Four 16 bit samples in the low half of `samples`, widened to floats.
+__m128 WidenSamples4(__m128i samples) {
+    return(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(samples, samples), 16)));
+}
+
+// The frame at `position` and the one after it, in the low bits.
+__m128i LoadFramePair(struct Sound* sound, u64 position, u32 channels) {
+    i16* frame = sound->samples + (position >> VOICE_FRACTION_BITS) * channels;
+
+    return((channels == 2) ? _mm_loadl_epi64((__m128i*)frame) : _mm_cvtsi32_si128(*(i32*)frame));
+}
+
+// Mixes `count` frames of the voice into the interleaved stereo accumulator.
+// The caller makes sure the voice doesn't run past the end of its sound.
+void MixVoiceFrames(struct Voice* voice, f32* out, u32 count) {
+    struct Sound* sound    = voice->sound;
+           u32    channels = sound->channel_count;
+           u64    position = voice->position;
+           u64    step     = voice->step;
+           u64    fraction = (1ULL << VOICE_FRACTION_BITS) - 1;
+
+    __m128 gains = _mm_setr_ps(voice->gain_left, voice->gain_right, voice->gain_left, voice->gain_right);
+
+    u32 i = 0;
+
+    // Playing at the mixer's rate from a whole frame is a straight copy, which
+    // is what most voices are doing most of the time.
+    if (step == (1ULL << VOICE_FRACTION_BITS) && (position & fraction) == 0) {
+        i16* source = sound->samples + (position >> VOICE_FRACTION_BITS) * channels;
+
+        if (channels == 2) {
+            for (; i + 4 <= count; i += 4) {
+                __m128i samples = _mm_loadu_si128((__m128i*)(source + i * 2));
+                __m128  first   = WidenSamples4(samples);
+                __m128  second  = WidenSamples4(_mm_srli_si128(samples, 8));
+
+                Accumulate4(out + i * 2, first, second, gains);
+            }
+        } else {
+            for (; i + 4 <= count; i += 4) {
+                __m128 mono = WidenSamples4(_mm_loadl_epi64((__m128i*)(source + i)));
+
+                Accumulate4(out + i * 2, _mm_unpacklo_ps(mono, mono), _mm_unpackhi_ps(mono, mono), gains);
+            }
+        }
+
+        position += (u64)i << VOICE_FRACTION_BITS;
+    }
+
+    // Otherwise each frame is blended from the two either side of it. Only
+    // finding the frames is scalar, everything after is four at a time. Each
+    // frame is read together with the one after it, moving samples into lanes
+    // one at a time costs more than the mixing does.
+    //
+    // The fractions are the low 32 bits of the positions, which wrap the same
+    // way in a 32 bit lane as they do in the full position.
+    u32     low_position  = (u32)position;
+    u32     low_step      = (u32)step;
+    __m128  to_fraction   = _mm_set1_ps(1.0f / (f32)(1 << 24));
+    __m128i fractions     = _mm_setr_epi32(
+        (i32)(low_position),
+        (i32)(low_position + low_step),
+        (i32)(low_position + low_step * 2),
+        (i32)(low_position + low_step * 3)
+    );
+    __m128i fraction_step = _mm_set1_epi32((i32)(low_step * 4));
+
+    for (; i + 4 <= count; i += 4) {
+        __m128i lane_0 = LoadFramePair(sound, position,            channels);
+        __m128i lane_1 = LoadFramePair(sound, position + step,     channels);
+        __m128i lane_2 = LoadFramePair(sound, position + step * 2, channels);
+        __m128i lane_3 = LoadFramePair(sound, position + step * 3, channels);
+
+        position += step * 4;
+
+        // Only the top 24 bits of each fraction fit in a float.
+        __m128 t = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(fractions, 8)), to_fraction);
+        fractions = _mm_add_epi32(fractions, fraction_step);
+
+        // Pairs of frames 0 and 1, then 2 and 3.
+        __m128i low  = _mm_unpacklo_epi32(lane_0, lane_1);
+        __m128i high = _mm_unpacklo_epi32(lane_2, lane_3);
+
+        __m128 l;
+        __m128 l_to;
+        __m128 r;
+        __m128 r_to;
+
+        if (channels == 2) {
+            // Left in the low half of each 32 bits, right in the high half.
+            __m128i from = _mm_unpacklo_epi64(low, high);
+            __m128i to   = _mm_unpackhi_epi64(low, high);
+
+            l    = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_slli_epi32(from, 16), 16));
+            r    = _mm_cvtepi32_ps(_mm_srai_epi32(from, 16));
+            l_to = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_slli_epi32(to, 16), 16));
+            r_to = _mm_cvtepi32_ps(_mm_srai_epi32(to, 16));
+        } else {
+            // The frame in the low half of each 32 bits, the next in the high.
+            __m128i pairs = _mm_unpacklo_epi64(low, high);
+
+            l    = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_slli_epi32(pairs, 16), 16));
+            l_to = _mm_cvtepi32_ps(_mm_srai_epi32(pairs, 16));
+            r    = l;
+            r_to = l_to;
+        }
+
+        l = _mm_add_ps(l, _mm_mul_ps(_mm_sub_ps(l_to, l), t));
+        r = _mm_add_ps(r, _mm_mul_ps(_mm_sub_ps(r_to, r), t));
+
+        Accumulate4(out + i * 2, _mm_unpacklo_ps(l, r), _mm_unpackhi_ps(l, r), gains);
+    }
+
+    f32 to_scalar_fraction = 1.0f / (f32)(1ULL << VOICE_FRACTION_BITS);
+
+    for (; i < count; i += 1) {
+        i16* frame = sound->samples + (position >> VOICE_FRACTION_BITS) * channels;
+        f32  t     = (f32)(position & fraction) * to_scalar_fraction;
+
+        f32 left  = frame[0] + (f32)(frame[channels] - frame[0]) * t;
+        f32 right = (channels == 2) ? frame[1] + (f32)(frame[3] - frame[1]) * t : left;
+
+        out[i * 2 + 0] += left  * voice->gain_left;
+        out[i * 2 + 1] += right * voice->gain_right;
+
+        position += step;
+    }
+
+    voice->position = position;
+}
+
+// Mixes in pieces that each stop at the end of the sound, where it either loops
+// or the voice is freed.
+void MixVoice(struct Voice* voice, f32* out, u32 frame_count) {
+    u32 done = 0;
+
+    while (done < frame_count && voice->sound) {
+        u64 end         = (u64)voice->sound->frame_count << VOICE_FRACTION_BITS;
+        u64 frames_left = (end - voice->position + voice->step - 1) / voice->step;
+        u32 count       = (u32)Min(frames_left, (u64)(frame_count - done));
+
+        MixVoiceFrames(voice, out + done * 2, count);
+        done += count;
+
+        // A step longer than the whole sound can go past the end more than
+        // once, like in SkipVoice.
+        if (voice->position >= end) {
+            if (voice->looping) {
+                voice->position %= end;
+            } else {
+                voice->sound = NULL;
+            }
+        }
+    }
+}
+
+// Moves a culled voice on as if it had been mixed, so it is in the right place
+// if the listener comes back within earshot.
+void SkipVoice(struct Voice* voice, u32 frame_count) {
+    u64 end = (u64)voice->sound->frame_count << VOICE_FRACTION_BITS;
+
+    voice->position += voice->step * frame_count;
+
+    if (voice->position >= end) {
+        if (voice->looping) {
+            voice->position %= end;
+        } else {
+            voice->sound = NULL;
+        }
+    }
+}
+
+void AddSamples(f32* out, f32* samples, u32 sample_count) {
+    u32 i = 0;
+
+    for (; i + 4 <= sample_count; i += 4) {
+        _mm_storeu_ps(out + i, _mm_add_ps(_mm_loadu_ps(out + i), _mm_loadu_ps(samples + i)));
+    }
+
+    for (; i < sample_count; i += 1) {
+        out[i] += samples[i];
+    }
+}
+
+// Runs each bus's effects and adds it onto the bus it feeds, last bus first.
+void RunMixBuses(struct Mixer* mixer, u32 frame_count) {
+    // Flush denormals to zero, or filter and reverb tails crawl as they die away.
+    u32 control = _mm_getcsr();
+    _mm_setcsr(control | 0x8040);
+
+    mixer->effects_milliseconds = 0.0f;
+
+    for (u32 i = MixBusCount - 1; i > MixBusMaster; i -= 1) {
+        struct MixBus* bus = &mixer->buses[i];
+
+        bus->milliseconds = 0.0f;
+
+        bool over_budget = mixer->effects_budget_milliseconds > 0.0f && mixer->effects_milliseconds >= mixer->effects_budget_milliseconds;
+
+        if ((bus->low_pass || bus->reverb) && !over_budget) {
+            u64 begin = GetWallClock();
+
+            if (bus->low_pass) {
+                RunLowPass(bus->low_pass, bus->samples, frame_count);
+            }
+
+            if (bus->reverb) {
+                RunReverb(bus->reverb, bus->samples, frame_count);
+            }
+
+            bus->milliseconds            = GetSecondsElapsed(begin, GetWallClock()) * 1000.0f;
+            mixer->effects_milliseconds += bus->milliseconds;
+        }
+
+        AddSamples(mixer->buses[bus->output].samples, bus->samples, frame_count * 2);
+    }
+
+    _mm_setcsr(control);
+}
+
+// Every playing voice, tone and the music are summed onto their buses in
+// floating point and only brought back to 16 bits at the end, where the pack
+// saturates so a loud mix clips instead of wrapping around.
+void MixAudio(struct Mixer* mixer, struct AudioBuffer* buffer, struct MemoryArena* arena) {
+    u32 frame_count  = buffer->samples_size / buffer->bytes_per_sample;
+    u32 sample_count = frame_count * 2;
+
+    for (u32 i = 0; i < MixBusCount; i += 1) {
+        mixer->buses[i].samples = PushArray(arena, f32, sample_count);
+        memset(mixer->buses[i].samples, 0, sample_count * sizeof(f32));
+    }
+
+    for (u32 i = 0; i < MAX_VOICES; i += 1) {
+        struct Voice* voice = &mixer->voices[i];
+
+        if (voice->sound) {
+            if (voice->positioned) {
+                PlaceVoice(mixer, voice);
+            }
+
+            if (voice->attenuation > 0.0f) {
+                MixVoice(voice, mixer->buses[voice->bus].samples, frame_count);
+            } else {
+                SkipVoice(voice, frame_count);
+            }
+        }
+    }
+
+    f32* accumulator = mixer->buses[MixBusMaster].samples;
+
+    if (mixer->synth) {
+        RenderSynth(mixer->synth, accumulator, frame_count);
+    }
+
+    if (mixer->music) {
+        MixMusic(mixer->music, accumulator, frame_count);
+    }
+
+    RunMixBuses(mixer, frame_count);
+
+    mixer->frames_mixed += frame_count;
+
+    i16*   out    = (i16*)buffer->samples;
+    __m128 master = _mm_set1_ps(mixer->master_volume);
+    u32    i      = 0;
+
+    for (; i + 8 <= sample_count; i += 8) {
+        __m128i first  = _mm_cvtps_epi32(_mm_mul_ps(_mm_loadu_ps(accumulator + i + 0), master));
+        __m128i second = _mm_cvtps_epi32(_mm_mul_ps(_mm_loadu_ps(accumulator + i + 4), master));
+
+        _mm_storeu_si128((__m128i*)(out + i), _mm_packs_epi32(first, second));
+    }
+
+    for (; i < sample_count; i += 1) {
+        out[i] = (i16)Clamp(accumulator[i] * mixer->master_volume, -32768.0f, 32767.0f);
+    }
+}
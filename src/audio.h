@@ -0,0 +1,170 @@
+// ==============================================
+// Audio
+// ==============================================
+
+// Interleaved 16 bit samples. One frame past the end is always allocated and
+// holds a copy of the first, so resampling can read the frame after the one it
+// is on without checking, and loops blend back round to the start.
+struct Sound {
+    i16* samples;
+    u32  frame_count;
+    u32  channel_count; // 1 or 2.
+    u32  samples_per_second;
+};
+
+// Sound effects loaded from data/audio at start up.
+enum SoundAsset {
+    SoundHit0,
+    SoundHit1,
+    SoundHit3,
+    SoundLoss0,
+    SoundLoss1,
+    SoundLoss2,
+    SoundPickup0,
+    SoundPickup1,
+    SoundPickup2,
+    SoundPowerup0,
+    SoundPowerup1,
+    SoundPowerup2,
+
+    SoundAssetCount,
+};
+
+// Things that happen in the game and make a noise. Each picks one of a run of
+// variations from the sound assets, see sound_events.
+enum SoundEvent {
+    SoundEventHit,
+    SoundEventLoss,
+    SoundEventPickup,
+    SoundEventPowerup,
+
+    SoundEventCount,
+
+    SoundEventNone = SoundEventCount,
+};
+
+struct SoundEventInfo {
+    enum SoundAsset first_variation;
+         u32        variation_count;
+         u32        max_instances;
+};
+
+// The parts of a WAV file's header that matter for loading it.
+struct WavFormat {
+    u32 channel_count;
+    u32 samples_per_second;
+    u32 bits_per_sample;   // 8 or 16.
+    u32 frame_count;
+    u8* data;
+};
+
+#define MAX_VOICES 256
+
+// An event's own voices are only cut off for a new one once they have played
+// this long, so a crowd triggering it every turn doesn't keep restarting it.
+#define SOUND_EVENT_MIN_SECONDS 0.05f
+
+// Positioned voices fade with distance from the listener, in tiles, down to
+// nothing at the hearing range. Past that they are culled: they keep their
+// place in the sound but aren't mixed. They are panned hard over once they are
+// this far off to one side.
+#define HEARING_RANGE_TILES 16.0f
+#define FULL_PAN_TILES      6.0f
+
+// Voices are mixed onto a bus, which runs its effects over everything on it in
+// one go and then adds it onto the bus it feeds. Buses only feed ones before
+// them, so running them from the last to the first gets it all to the master.
+enum MixBusId {
+    MixBusMaster,  // Music and the synth, and everything else by the end.
+    MixBusWorld,   // Sounds in the game world, through the room's reverb.
+    MixBusMuffled, // Sounds the listener can't see, low passed on their way to the world.
+
+    MixBusCount,
+};
+
+// Where sounds out of sight are cut off, in Hz.
+#define MUFFLED_CUTOFF 700.0f
+
+struct MixBus {
+    enum MixBusId output;
+         f32*     samples; // This mix's interleaved stereo, in the transient arena.
+
+    // Run in this order when set.
+    struct LowPass* low_pass;
+    struct Reverb*  reverb;
+
+    // How long the effects took last mix, zero when they didn't run.
+           f32      milliseconds;
+};
+
+// Positions are in frames of the sound, 32.32 fixed point.
+#define VOICE_FRACTION_BITS 32
+
+struct Voice {
+    struct Sound* sound; // NULL when the voice is free.
+           u64    position;
+           u64    step;
+           f32    volume;
+           f32    pan;   // -1 is hard left, 1 is hard right.
+           f32    pitch;
+           bool   looping;
+
+    // Voices placed on the tile map work out their pan and attenuation from
+    // where they are relative to the listener. Others keep an attenuation of 1.
+           bool   positioned;
+           f32    x;
+           f32    y;
+           f32    attenuation;
+
+    // Worked out from the volume, attenuation and pan whenever they change.
+           f32    gain_left;
+           f32    gain_right;
+
+    // Bumped each time the voice is reused, so stale ids stop matching.
+           u32    generation;
+
+    // What started the voice and when, for picking one to steal.
+           u32    event;
+           u64    start_frame;
+
+           u32    bus;
+};
+
+// Identifies a playing voice, the index in the low bits and the generation
+// above them. Zero is never a valid id.
+typedef u32 VoiceId;
+
+#define VOICE_INDEX_BITS 8
+
+struct Mixer {
+    struct Voice        voices[MAX_VOICES];
+           u32          samples_per_second;
+           f32          master_volume;
+           u64          frames_mixed;
+
+    // Where the positioned voices are heard from, in tiles. Those the listener
+    // can't see are muffled, when it has something to see with.
+           f32          listener_x;
+           f32          listener_y;
+    struct Visibility*  listener_sight;
+
+    // Buses whose effects would start after the budget has been spent just
+    // pass their input on for the mix, so effects can't hold up the frame.
+    struct MixBus       buses[MixBusCount];
+    struct LowPass      muffle;
+    struct Reverb       room;
+           f32          effects_budget_milliseconds;
+           f32          effects_milliseconds;
+
+    // Picks sound event variations, never repeating the last one.
+           u32          random_state;
+           u32          last_variation[SoundEventCount];
+
+    // Set when an event has no voice it can take, so the rest of a crowd
+    // triggering it before the next mix are turned away without a search.
+           u64          event_full_at[SoundEventCount];
+
+    // Mixed in along with the voices when set.
+    struct Synth*       synth;
+    struct MusicStream* music;
+};
@@ -0,0 +1,193 @@
+// ==============================================
+// Effects
+// ==============================================
+
+// ==============================================
+// Low Pass
+
+// The usual biquad low pass, with a Q of one over root two so a single pass
+// has no bump at the cutoff.
+void SetLowPass(struct LowPass* filter, f32 cutoff, u32 samples_per_second) {
+    f32 omega = 2.0f * PI * Min(cutoff, 0.45f * (f32)samples_per_second) / (f32)samples_per_second;
+    f32 alpha = sinf(omega) / (2.0f * 0.70710678f);
+    f32 cosw  = cosf(omega);
+    f32 a0    = 1.0f + alpha;
+
+    filter->cutoff = cutoff;
+    filter->b0     = (1.0f - cosw) * 0.5f / a0;
+    filter->b1     = (1.0f - cosw)        / a0;
+    filter->b2     = (1.0f - cosw) * 0.5f / a0;
+    filter->a1     = -2.0f * cosw         / a0;
+    filter->a2     = (1.0f - alpha)       / a0;
+}
+
+// Filters in place. Each frame is loaded into the low half of the register,
+// with the first pass's output from the frame before in the high half, and the
+// second pass's output is stored from the high half.
+void RunLowPass(struct LowPass* filter, f32* samples, u32 frame_count) {
+    __m128 b0 = _mm_set1_ps(filter->b0);
+    __m128 b1 = _mm_set1_ps(filter->b1);
+    __m128 b2 = _mm_set1_ps(filter->b2);
+    __m128 a1 = _mm_set1_ps(filter->a1);
+    __m128 a2 = _mm_set1_ps(filter->a2);
+
+    __m128 z1 = _mm_loadu_ps(filter->z1);
+    __m128 z2 = _mm_loadu_ps(filter->z2);
+    __m128 y  = _mm_setr_ps(filter->first_pass[0], filter->first_pass[1], 0.0f, 0.0f);
+
+    for (u32 i = 0; i < frame_count; i += 1) {
+        f32*   frame = samples + i * 2;
+        __m128 x     = _mm_movelh_ps(_mm_castpd_ps(_mm_load_sd((f64*)frame)), y);
+
+        y  = _mm_add_ps(_mm_mul_ps(b0, x), z1);
+        z1 = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(b1, x), _mm_mul_ps(a1, y)), z2);
+        z2 = _mm_sub_ps(_mm_mul_ps(b2, x), _mm_mul_ps(a2, y));
+
+        _mm_storeh_pi((__m64*)frame, y);
+    }
+
+    _mm_storeu_ps(filter->z1, z1);
+    _mm_storeu_ps(filter->z2, z2);
+    _mm_storel_pi((__m64*)filter->first_pass, y);
+}
+
+// ==============================================
+// Reverb
+
+// In milliseconds, far enough apart that the echoes smear into each other
+// rather than ringing.
+static f32 reverb_delays[REVERB_LINES] = { 29.7f, 37.1f, 41.1f, 43.7f };
+
+void InitReverb(struct Reverb* reverb, u32 samples_per_second, struct MemoryArena* arena) {
+    *reverb = (struct Reverb){
+        .line_size          = 1,
+        .samples_per_second = samples_per_second,
+        .feedback           = 0.0f,
+        .is_clear           = true,
+    };
+
+    for (u32 i = 0; i < REVERB_LINES; i += 1) {
+        reverb->delays[i] = (u32)(reverb_delays[i] * 0.001f * (f32)samples_per_second);
+    }
+
+    // Room for the longest delay, and the frame before it that damping reads.
+    while (reverb->line_size < reverb->delays[REVERB_LINES - 1] + 8) {
+        reverb->line_size *= 2;
+    }
+
+    for (u32 i = 0; i < REVERB_LINES; i += 1) {
+        reverb->lines[i] = PushArray(arena, f32, reverb->line_size + 4);
+        memset(reverb->lines[i], 0, (reverb->line_size + 4) * sizeof(f32));
+    }
+}
+
+// The feedback is whatever takes a signal down by 60 dB in `decay_seconds`,
+// going round the average line.
+void SetReverb(struct Reverb* reverb, f32 wet, f32 decay_seconds) {
+    f32 average_delay = 0.0f;
+
+    for (u32 i = 0; i < REVERB_LINES; i += 1) {
+        average_delay += (f32)reverb->delays[i] / REVERB_LINES;
+    }
+
+    f32 trips = Max(decay_seconds, 0.01f) * (f32)reverb->samples_per_second / average_delay;
+
+    reverb->target_wet = wet;
+    reverb->feedback   = powf(10.0f, -3.0f / trips);
+}
+
+void WriteReverbLine(struct Reverb* reverb, f32* line, __m128 value) {
+    u32 size  = reverb->line_size;
+    u32 write = reverb->write;
+
+    _mm_storeu_ps(line + write, value);
+
+    // Keep the copies past the end in step with the first four frames.
+    for (u32 i = size; i < write + 4; i += 1) {
+        line[i - size] = line[i];
+    }
+
+    for (u32 i = write; i < 4; i += 1) {
+        line[size + i] = line[i];
+    }
+}
+
+// Adds the reverb onto the samples in place, four frames at a time with a frame
+// in each lane. Lines take the left or right input in turn, and the output is
+// read off the lines before they are mixed back in. Averaging each read with
+// the frame before it damps the high end a little more on every trip round,
+// like the walls of a real room.
+void RunReverb(struct Reverb* reverb, f32* samples, u32 frame_count) {
+    bool is_silent = reverb->wet == 0.0f && reverb->target_wet == 0.0f;
+
+    if (is_silent) {
+        // Whatever was left ringing would come back the next time it's used.
+        if (!reverb->is_clear) {
+            for (u32 i = 0; i < REVERB_LINES; i += 1) {
+                memset(reverb->lines[i], 0, (reverb->line_size + 4) * sizeof(f32));
+            }
+
+            reverb->write    = 0;
+            reverb->is_clear = true;
+        }
+    } else {
+        reverb->is_clear = false;
+
+        u32    mask     = reverb->line_size - 1;
+        f32    wet      = reverb->wet;
+        f32    wet_step = (reverb->target_wet - reverb->wet) / (f32)Max(frame_count, 1);
+        __m128 half     = _mm_set1_ps(0.5f);
+        __m128 feedback = _mm_set1_ps(reverb->feedback * 0.5f); // The Hadamard matrix's scale folded in.
+
+        for (u32 i = 0; i < frame_count; i += 4) {
+            u32  lanes  = Min(4, frame_count - i);
+            f32* frames = samples + i * 2;
+            f32  partial[8] = {};
+
+            if (lanes < 4) {
+                memcpy(partial, frames, lanes * 2 * sizeof(f32));
+                frames = partial;
+            }
+
+            __m128 first  = _mm_loadu_ps(frames + 0);
+            __m128 second = _mm_loadu_ps(frames + 4);
+            __m128 left   = _mm_mul_ps(_mm_shuffle_ps(first, second, _MM_SHUFFLE(2, 0, 2, 0)), half);
+            __m128 right  = _mm_mul_ps(_mm_shuffle_ps(first, second, _MM_SHUFFLE(3, 1, 3, 1)), half);
+
+            __m128 reads[REVERB_LINES];
+
+            for (u32 line = 0; line < REVERB_LINES; line += 1) {
+                u32 start  = (reverb->write - reverb->delays[line]) & mask;
+                u32 before = (start - 1) & mask;
+
+                reads[line] = _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(reverb->lines[line] + start), _mm_loadu_ps(reverb->lines[line] + before)), half);
+            }
+
+            __m128 sum_01        = _mm_add_ps(reads[0], reads[1]);
+            __m128 difference_01 = _mm_sub_ps(reads[0], reads[1]);
+            __m128 sum_23        = _mm_add_ps(reads[2], reads[3]);
+            __m128 difference_23 = _mm_sub_ps(reads[2], reads[3]);
+
+            WriteReverbLine(reverb, reverb->lines[0], _mm_add_ps(_mm_mul_ps(_mm_add_ps(sum_01,        sum_23),        feedback), left));
+            WriteReverbLine(reverb, reverb->lines[1], _mm_add_ps(_mm_mul_ps(_mm_add_ps(difference_01, difference_23), feedback), right));
+            WriteReverbLine(reverb, reverb->lines[2], _mm_add_ps(_mm_mul_ps(_mm_sub_ps(sum_01,        sum_23),        feedback), left));
+            WriteReverbLine(reverb, reverb->lines[3], _mm_add_ps(_mm_mul_ps(_mm_sub_ps(difference_01, difference_23), feedback), right));
+
+            __m128 gain      = _mm_set1_ps(wet);
+            __m128 out_left  = _mm_mul_ps(_mm_add_ps(reads[0], reads[2]), gain);
+            __m128 out_right = _mm_mul_ps(_mm_add_ps(reads[1], reads[3]), gain);
+
+            _mm_storeu_ps(frames + 0, _mm_add_ps(first,  _mm_unpacklo_ps(out_left, out_right)));
+            _mm_storeu_ps(frames + 4, _mm_add_ps(second, _mm_unpackhi_ps(out_left, out_right)));
+
+            if (lanes < 4) {
+                memcpy(samples + i * 2, partial, lanes * 2 * sizeof(f32));
+            }
+
+            reverb->write  = (reverb->write + lanes) & mask;
+            wet           += wet_step * (f32)lanes;
+        }
+
+        reverb->wet = reverb->target_wet;
+    }
+}
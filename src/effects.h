@@ -0,0 +1,44 @@
+// ==============================================
+// Effects
+// ==============================================
+
+// A low pass biquad, run twice in a row for a steep 24 dB per octave cut, over
+// interleaved stereo. Both passes of both channels share one register, the
+// second pass working on what the first produced a frame earlier, so the
+// filter costs one biquad's worth of arithmetic and is a frame late.
+struct LowPass {
+    f32 cutoff;
+    f32 b0;
+    f32 b1;
+    f32 b2;
+    f32 a1;
+    f32 a2;
+
+    // Lanes are the left and right of the first pass, then of the second.
+    f32 z1[4];
+    f32 z2[4];
+    f32 first_pass[2]; // The first pass's last frame, waiting for the second.
+};
+
+#define REVERB_LINES 4
+
+// A feedback delay network: four delay lines mixed back into each other
+// through a Hadamard matrix. Every line is longer than four frames, so four
+// frames of all four lines can be read, mixed and written back at once.
+//
+// Each line has four frames past the end holding copies of the first four, so
+// reads starting anywhere never have to wrap.
+struct Reverb {
+    f32* lines[REVERB_LINES];
+    u32  line_size;  // A power of two.
+    u32  delays[REVERB_LINES];
+    u32  write;
+    u32  samples_per_second;
+
+    f32  feedback;
+
+    // The wet level slides to the target over each mix rather than jumping.
+    f32  wet;
+    f32  target_wet;
+    bool is_clear;
+};
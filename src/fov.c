@@ -0,0 +1,66 @@
+// ==============================================
+// Field of View
+// ==============================================
+
+void InitVisibility(struct Visibility* fov, i32 radius, struct MemoryArena* arena) {
+    fov->radius   = radius;
+    fov->size     = radius * 2 + 1;
+    fov->bits     = PushArray(arena, u64, (fov->size * fov->size + 63) / 64);
+    fov->is_valid = false;
+}
+
+bool CanSee(struct Visibility* fov, i32 x, i32 y) {
+    i32 dx = x - fov->origin_x + fov->radius;
+    i32 dy = y - fov->origin_y + fov->radius;
+
+    bool result = false;
+
+    if (dx >= 0 && dy >= 0 && dx < fov->size && dy < fov->size) {
+        u32 bit = dx + dy * fov->size;
+        result  = (fov->bits[bit / 64] >> (bit % 64)) & 1;
+    }
+
+    return(result);
+}
+
+void VisitVisibleTile(void* data, i32 x, i32 y) {
+    struct Visibility* fov = (struct Visibility*)data;
+
+    u32 bit = (x - fov->origin_x + fov->radius) + (y - fov->origin_y + fov->radius) * fov->size;
+    fov->bits[bit / 64] |= 1ULL << (bit % 64);
+}
+
+// A field of view only goes stale when its actor moves, or when a tile that
+// blocks sight changes somewhere inside of its window.
+bool IsVisibilityStale(struct Visibility* fov, struct TileMap* map, i32 x, i32 y) {
+    bool is_stale = !fov->is_valid || fov->origin_x != x || fov->origin_y != y;
+
+    u32 pending = map->blocking_change_count - fov->blocking_changes_seen;
+
+    if (pending > TILE_CHANGE_LOG_SIZE) {
+        // Too much has changed since we last looked to know what it was.
+        is_stale = true;
+    }
+
+    for (u32 i = fov->blocking_changes_seen; i != map->blocking_change_count && !is_stale; i += 1) {
+        struct TileChange* change = &map->blocking_changes[i & (TILE_CHANGE_LOG_SIZE - 1)];
+
+        is_stale = Abs(change->x - x) <= fov->radius
+                && Abs(change->y - y) <= fov->radius;
+    }
+
+    return(is_stale);
+}
+
+void UpdateVisibility(struct Visibility* fov, struct TileMap* map, i32 x, i32 y) {
+    if (IsVisibilityStale(fov, map, x, y)) {
+        fov->origin_x = x;
+        fov->origin_y = y;
+        fov->is_valid = true;
+
+        memset(fov->bits, 0, ((fov->size * fov->size + 63) / 64) * sizeof(u64));
+        CastShadows(map, x, y, fov->radius, VisitVisibleTile, fov);
+    }
+
+    fov->blocking_changes_seen = map->blocking_change_count;
+}
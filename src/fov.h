@@ -0,0 +1,17 @@
+// ==============================================
+// Field of View
+// ==============================================
+
+// The tiles an actor can see, one bit per tile in a square window centred on
+// the actor that is just big enough to hold its sight radius.
+struct Visibility {
+    i32  origin_x;
+    i32  origin_y;
+    i32  radius;
+    i32  size;
+    u64* bits;
+
+    // Where in the tile map's blocking change log this was last brought up to date.
+    bool is_valid;
+    u32  blocking_changes_seen;
+};
@@ -1,65 +1,193 @@
 #include "locale.h"
-#include "game.h"
 #include "maths.h"
+#include "arena.h"
+#include "render.h"
+#include "palette.h"
+#include "lighting.h"
+#include "fov.h"
+#include "particles.h"
+#include "static_layer.h"
+#include "post_process.h"
+#include "animation.h"
+#include "minimap.h"
+#include "synth.h"
+#include "effects.h"
+#include "audio.h"
+#include "music.h"
+#include "game.h"
+#include "tile_map.c"
+#include "shadowcast.c"
+#include "fov.c"
+#include "lighting.c"
+#include "render.c"
+#include "particles.c"
+#include "static_layer.c"
+#include "post_process.c"
+#include "animation.c"
+#include "minimap.c"
+#include "geometry.c"
+#include "effects.c"
+#include "audio.c"
+#include "synth.c"
+#include "music.c"
 
-void DrawRect(
-    struct OffscreenBuffer* buffer,
-    u32 x, u32 y, u32 w, u32 h,
-    u8 r, u8 g, u8 b
-) {
-    u32 min_x = x;
-    u32 max_x = Min(x + w, buffer->width);
-    u32 min_y = y;
-    u32 max_y = Min(y + h, buffer->height);
-
-    u32 colour = (
-        (0xFF << 24) |
-        (r    << 16) |
-        (g    << 8)  |
-        (b    << 0)
-    );
+void AddLight(struct GameState* state, i32 x, i32 y, i32 radius, u32 colour) {
+    Assert(state->light_count < MAX_LIGHTS);
 
-    u8* row = (u8*)buffer->pixels
-            + min_x * buffer->bytes_per_pixel
-            + min_y * buffer->pitch;
+    if (state->light_count < MAX_LIGHTS) {
+        struct Light* light = &state->lights[state->light_count++];
 
-    for (u32 y = min_y; y < max_y; y += 1) {
-        u32* pixel = (u32*)row;
+        light->x      = x;
+        light->y      = y;
+        light->radius = radius;
+        light->colour = colour;
 
-        for (u32 x = min_x; x < max_x; x += 1) {
-            *pixel++ = colour;
-        }
+        state->lights_version += 1;
+    }
+}
+
+// ==============================================
+// Actors
+// ==============================================
+
+bool IsWalkable(struct GameState* state, i32 x, i32 y) {
+    return(!TileBlocksLight(&state->tile_map, x, y));
+}
+
+struct Actor* AddActor(struct GameState* state, i32 x, i32 y, i32 sight_radius, enum AnimationSet set) {
+    Assert(state->actor_count < MAX_ACTORS);
+
+    struct Actor* actor = &state->actors[state->actor_count++];
+    actor->x             = x;
+    actor->y             = y;
+    actor->animation_set = set;
+    actor->facing        = FacingDown;
+    actor->animator      = AddAnimator(&state->animators, &state->frame_table, set, FacingDown);
+    InitVisibility(&actor->fov, sight_radius, &state->permanent_arena);
 
-        row += buffer->pitch;
+    return(actor);
+}
+
+void PlayActorAnimation(struct GameState* state, struct Actor* actor, enum AnimationAction action) {
+    PlayAnimation(&state->animators, &state->frame_table, actor->animator, actor->animation_set, action, actor->facing);
+}
+
+// Returns whether the actor actually moved.
+bool TryMoveActor(struct GameState* state, struct Actor* actor, i32 move_x, i32 move_y) {
+    struct Actor* player = &state->actors[0];
+
+    i32 x = actor->x + move_x;
+    i32 y = actor->y + move_y;
+
+    bool onto_player = actor != player && x == player->x && y == player->y;
+
+    bool moved = IsWalkable(state, x, y) && !onto_player;
+
+    if (moved) {
+        actor->x = x;
+        actor->y = y;
+        PlayActorAnimation(state, actor, ActionWalk);
     }
+
+    return(moved);
 }
 
-struct RenderInfo {
-    struct OffscreenBuffer* buffer;
+// Demons that can see the player close in on them and attack once they are
+// next to them, the rest wander about.
+void TakeDemonTurns(struct GameState* state) {
+    struct Actor* player = &state->actors[0];
+
+    for (u32 i = 1; i < state->actor_count; i += 1) {
+        struct Actor* demon = &state->actors[i];
+
+        i32 distance_x = player->x - demon->x;
+        i32 distance_y = player->y - demon->y;
+
+        if (CanSee(&demon->fov, player->x, player->y)) {
+            if (Abs(distance_x) <= 1 && Abs(distance_y) <= 1) {
+                state->damage_flash = DAMAGE_FLASH_FRAMES;
 
-    u32 x;
-    u32 y;
-    u32 w;
-    u32 h;
+                demon->facing = FacingFromDirection(distance_x, distance_y);
+                PlayActorAnimation(state, demon, ActionAttack);
+                PlaySoundEvent(&state->mixer, state->sounds, SoundEventLoss, 0.4f, demon->x + 0.5f, demon->y + 0.5f);
 
-    u8 r;
-    u8 g;
-    u8 b;
+                EmitParticles(
+                    &state->particles, &state->random_state, 64,
+                    (player->x + 0.5f) * TILE_SIZE_PIXELS, (player->y + 0.5f) * TILE_SIZE_PIXELS,
+                    0.0f, 0.0f, 160.0f, 0.6f, ARGB(0xFF, 200, 20, 10)
+                );
+            } else {
+                demon->facing = FacingFromDirection(Sign(distance_x), Sign(distance_y));
+                TryMoveActor(state, demon, Sign(distance_x), Sign(distance_y));
+            }
+        } else {
+            u32 direction = NextRandom(&state->random_state) % 9;
+            i32 move_x    = (i32)(direction % 3) - 1;
+            i32 move_y    = (i32)(direction / 3) - 1;
+
+            if (move_x != 0 || move_y != 0) {
+                demon->facing = FacingFromDirection(move_x, move_y);
+                TryMoveActor(state, demon, move_x, move_y);
+            }
+        }
+    }
+}
 
-    u32 x_offset;
-    u32 y_offset;
+struct VisibilityJob {
+    struct TileMap* map;
+    struct Actor*   actors;
+           u32      count;
 };
 
-void ThreadDrawRect(void* data) {
-    struct RenderInfo* job = (struct RenderInfo*)data;
-    DrawRect(job->buffer, job->x, job->y, job->w, job->h, job->r, job->g, job->b);
+void ThreadUpdateVisibility(void* data) {
+    struct VisibilityJob* job = (struct VisibilityJob*)data;
+
+    for (u32 i = 0; i < job->count; i += 1) {
+        struct Actor* actor = &job->actors[i];
+        UpdateVisibility(&actor->fov, job->map, actor->x, actor->y);
+    }
+}
+
+// Only actors that moved, or that were near a changed wall, actually recompute
+// anything. The rest just catch up with the change log.
+void UpdateActorVisibility(struct GameState* state, struct JobQueue* queue) {
+    u32 job_count = Min(state->actor_count, Min(CpuCoreCount(queue) * 4, MAX_VISIBILITY_JOBS));
+    struct VisibilityJob* jobs = PushArray(&state->transient_arena, struct VisibilityJob, job_count);
+
+    for (u32 i = 0; i < job_count; i += 1) {
+        u32 first = state->actor_count *  i      / job_count;
+        u32 last  = state->actor_count * (i + 1) / job_count;
+
+        jobs[i].map    = &state->tile_map;
+        jobs[i].actors = state->actors + first;
+        jobs[i].count  = last - first;
+
+        PushJob(queue, &jobs[i], ThreadUpdateVisibility);
+    }
+
+    CompleteRemainingWork(queue);
+}
+
+// ==============================================
+// Audio
+// ==============================================
+
+// Hears from the middle of a tile, with whatever can't be seen from there
+// muffled, and the hallways echoing.
+void UpdateListener(struct Mixer* mixer, struct TileMap* map, i32 x, i32 y, struct Visibility* sight) {
+    bool in_hallway = GetTile(map, x, y) == HallwayFloor;
+
+    SetListener(mixer, x + 0.5f, y + 0.5f, sight);
+    SetReverb(&mixer->room, in_hallway ? 0.35f : 0.0f, 1.2f);
 }
 
 void UpdateAndRender(
     struct Memory*          memory,
     struct InputState*      input_state,
     struct JobQueue*        queue,
+    struct JobQueue*        background_queue,
     struct OffscreenBuffer* offscreen_buffer,
+    struct GeometryBuffer*  geometry_buffer,
     struct AudioBuffer*     audio_buffer
 ) {
     struct GameState* state = (struct GameState*)memory->permanent;
@@ -69,89 +197,520 @@ void UpdateAndRender(
         state->x_offset    = 0;
         state->y_offset    = 0;
         state->locale      = &en_gb;
+
+        InitArena(
+            &state->permanent_arena,
+            (u8*)memory->permanent + sizeof(struct GameState),
+            memory->permanent_size - sizeof(struct GameState)
+        );
+
+        GenerateSchool(&state->tile_map, &state->permanent_arena);
+
+        InitStaticLayer(&state->static_layer, &state->tile_map, &state->permanent_arena);
+        state->use_static_layer = true;
+
+        InitMinimap(&state->minimap, &state->tile_map, &state->permanent_arena);
+        state->show_minimap = true;
+
+        // It is night time, so outside of the lights there is only a little moonlight.
+        InitLightMap(&state->light_map, &state->tile_map, &state->permanent_arena, ARGB(0xFF, 40, 40, 70));
+        state->per_pixel_lighting = true;
+        state->use_indexed_target = true;
+
+        u32 torch     = ARGB(0xFF, 255, 170,  90);
+        u32 street    = ARGB(0xFF, 255, 240, 200);
+        u32 pentagram = ARGB(0xFF, 255,  40,  30);
+
+        for (i32 x = 66; x < 118; x += 10) {
+            AddLight(state, x, 29, 8, torch);
+        }
+
+        for (i32 y = 12; y < 50; y += 10) {
+            AddLight(state, 89, y, 8, torch);
+        }
+
+        for (i32 x = 8; x < (i32)state->tile_map.width; x += 16) {
+            AddLight(state, x, state->tile_map.height - 4, 10, street);
+        }
+
+        AddLight(state, 104, 40, 10, pentagram);
+
+        // Glowing, dark around the edges and a little bit haunted television.
+        {
+            struct PostProcess* post = &state->post_process;
+
+            AddPostPass(post, PostPassBloom);
+            AddPostPass(post, PostPassVignette);
+            AddPostPass(post, PostPassCrt);
+
+            post->budget_milliseconds = 4.0f;
+            post->bloom_threshold     = 150;
+            post->bloom_strength      = 200;
+            post->bloom_blur_passes   = 2;
+            post->vignette_corner     = 90;
+            post->crt_scanline        = 200;
+            post->crt_mask            = 215;
+        }
+
+        InitParticleSystem(&state->particles, MAX_PARTICLES, &state->permanent_arena);
+        state->particles.gravity      = 60.0f;
+        state->particles.drag         = 1.5f;
+        state->particles.fade_seconds = 0.75f;
+
+        BakeAnimations(&state->frame_table, &state->actor_atlas, &state->permanent_arena);
+        InitAnimators(&state->animators, MAX_ACTORS, &state->permanent_arena);
+
+        // Sound effects, and the same steady hum as always.
+        {
+            InitMixer(&state->mixer, audio_buffer->samples_per_second, &state->permanent_arena);
+            state->mixer.effects_budget_milliseconds = 1.0f;
+            LoadSoundAssets(state->sounds, audio_buffer->samples_per_second, &state->permanent_arena);
+
+            InitSynth(&state->synth, audio_buffer->samples_per_second);
+            state->mixer.synth = &state->synth;
+
+            struct ToneParams hum = {
+                .waveform  = WaveformSine,
+                .frequency = 256.0f,
+                .volume    = 0.13f,
+                .envelope  = { .attack = 0.05f, .sustain = 1.0f },
+            };
+
+            PlayTone(&state->synth, &hum);
+
+            // No track ships yet, the game plays without one if it's missing.
+            InitMusicStream(&state->music, &state->permanent_arena, background_queue);
+            state->mixer.music = &state->music;
+
+            PlayMusic(&state->music, &state->mixer, "data/audio/music.wav", 0.5f, true);
+        }
+
+        // The player starts just inside the front gate.
+        state->random_state = 0x5EED;
+        AddActor(state, 89, 70, 12, AnimationPlayer);
+
+        struct TileMap* map = &state->tile_map;
+
+        for (u32 i = 0; i < DEMON_COUNT; i += 1) {
+            i32 x;
+            i32 y;
+
+            do {
+                x = NextRandom(&state->random_state) % map->width;
+                y = NextRandom(&state->random_state) % (map->height - 6);
+            } while (!IsWalkable(state, x, y));
+
+            AddActor(state, x, y, 8, AnimationDemon);
+        }
     }
 
-    state->x_offset += 1; // input_state->move_horizontal;
-    state->y_offset += 1; // input_state->move_vertical;
+    // Anything in the transient arena only lives until the end of the frame.
+    InitArena(&state->transient_arena, memory->transient, memory->transient_size);
 
-    // audio
+    struct Actor* player = &state->actors[0];
+
+    // turns
     {
-        static i32 tone_hz      = 256;
-        static i16 tone_volume  = 3000;
-        static f32 sample_index = 0.0f;
+        i32 move_x = input_state->move_right.is_down - input_state->move_left.is_down;
+        i32 move_y = input_state->move_down.is_down  - input_state->move_up.is_down;
 
-        i32  wave_period  = audio_buffer->samples_per_second / tone_hz;
-        i32  sample_count = audio_buffer->samples_size / audio_buffer->bytes_per_sample;
-        u16* samples      = audio_buffer->samples;
+        if (move_x == 0 && move_y == 0) {
+            state->turn_cooldown = 0;
+        } else if (state->turn_cooldown > 0) {
+            state->turn_cooldown -= 1;
+        } else {
+            // Holding shift lets the player back away while still facing something.
+            if (!input_state->maintain_facing.is_down) {
+                player->facing = FacingFromDirection(move_x, move_y);
+            }
 
-        for (i32 i = 0; i < sample_count; i += 1) {
-            f32 sin_value = sinf(2.0f * PI * sample_index / (f32)wave_period);
-            i16 sample_value = (i16)(sin_value * tone_volume);
+            TryMoveActor(state, player, move_x, move_y);
+            TakeDemonTurns(state);
 
-            *samples++ = sample_value;
-            *samples++ = sample_value;
+            state->turn_cooldown = TURN_REPEAT_FRAMES;
+        }
 
-            sample_index += 1.0f;
+        if (input_state->action.is_down && !input_state->action.was_down) {
+            PlayActorAnimation(state, player, ActionAttack);
+            PlaySoundEvent(&state->mixer, state->sounds, SoundEventHit, 0.5f, player->x + 0.5f, player->y + 0.5f);
         }
+
+        UpdateMusic(&state->music);
+        UpdateActorVisibility(state, queue);
+        UpdateAnimators(&state->animators, &state->frame_table, input_state->seconds_per_frame);
+    }
+
+    // camera
+    {
+        i32 max_x = Max((i32)(state->tile_map.width  * TILE_SIZE_PIXELS) - offscreen_buffer->width,  0);
+        i32 max_y = Max((i32)(state->tile_map.height * TILE_SIZE_PIXELS) - offscreen_buffer->height, 0);
+
+        i32 centre_x = player->x * TILE_SIZE_PIXELS + TILE_SIZE_PIXELS / 2 - offscreen_buffer->width  / 2;
+        i32 centre_y = player->y * TILE_SIZE_PIXELS + TILE_SIZE_PIXELS / 2 - offscreen_buffer->height / 2;
+
+        state->x_offset = Clamp(centre_x, 0, max_x);
+        state->y_offset = Clamp(centre_y, 0, max_y);
+    }
+
+    // audio
+    {
+        UpdateListener(&state->mixer, &state->tile_map, player->x, player->y, &player->fov);
+        MixAudio(&state->mixer, audio_buffer, &state->transient_arena);
+    }
+
+    // particles
+    {
+        // Embers drift up off the pentagram.
+        EmitParticles(
+            &state->particles, &state->random_state, 4,
+            104.5f * TILE_SIZE_PIXELS, 40.5f * TILE_SIZE_PIXELS,
+            0.0f, -90.0f, 30.0f, 1.5f, ARGB(0xFF, 120, 40, 10)
+        );
+
+        UpdateParticles(&state->particles, input_state->seconds_per_frame, queue, &state->transient_arena);
     }
 
     // rendering
     {
-        u32 pixel_width  = offscreen_buffer->width;
-        u32 pixel_height = offscreen_buffer->height;
-
-        u32 cpu_core_count          = CpuCoreCount(queue);
-        u32 pixels_per_chunk_width  = pixel_width  / (cpu_core_count / 2);
-        u32 pixels_per_chunk_height = pixel_height / (cpu_core_count / 2);
-
-        u32 remaining_pixels_x = pixel_width  % pixels_per_chunk_width;
-        u32 remaining_pixels_y = pixel_height % pixels_per_chunk_height;
-        u32 chunks_per_width   = pixel_width  / pixels_per_chunk_width;
-        u32 chunks_per_height  = pixel_height / pixels_per_chunk_height;
-        u32 total_chunks       = chunks_per_width * chunks_per_height;
-
-        // Allocate into an arena instead.
-        StackAlloc(struct RenderInfo, jobs, total_chunks);
-
-        for (u32 y = 0; y < chunks_per_height; y += 1) {
-            for (u32 x = 0; x < chunks_per_width; x += 1) {
-                u32 index = x + y * chunks_per_width;
-                struct RenderInfo* job = &jobs[index];
-
-                bool last_row = y == chunks_per_height - 1;
-                bool last_col = x == chunks_per_width  - 1;
-
-                job->buffer   = offscreen_buffer;
-                job->x        = x * pixels_per_chunk_width;
-                job->y        = y * pixels_per_chunk_height;
-                job->w        = pixels_per_chunk_width  + (last_col ? remaining_pixels_x : 0);
-                job->h        = pixels_per_chunk_height + (last_row ? remaining_pixels_y : 0);
-                job->r        = (255 / chunks_per_width  * x);
-                job->g        = (255 / chunks_per_height * y);
-                job->b        = 0;
-                job->x_offset = state->x_offset;
-                job->y_offset = state->y_offset;
-
-                PushJob(queue, job, ThreadDrawRect);
+        struct RenderGroup* group = AllocateRenderGroup(&state->transient_arena, MAX_SPRITES_PER_FRAME);
+        group->layouts = &state->tile_layouts;
+
+        // Whole screen colour effects are done on the palette rather than the pixels.
+        {
+            bool is_hunted = false;
+
+            for (u32 i = 1; i < state->actor_count && !is_hunted; i += 1) {
+                is_hunted = CanSee(&state->actors[i].fov, player->x, player->y);
+            }
+
+            CopyPalette(&state->palette, base_palette, ArrayCount(base_palette));
+
+            if (is_hunted) {
+                TintPalette(&state->palette, ARGB(0xFF, 255, 210, 210));
+            }
+
+            if (state->damage_flash > 0) {
+                BlendPalette(&state->palette, ARGB(0xFF, 255, 255, 255), state->damage_flash * 255 / DAMAGE_FLASH_FRAMES);
+                state->damage_flash -= 1;
             }
+
+            group->palette = &state->palette;
         }
 
-        CompleteRemainingWork(queue);
+        // The geometry backend draws straight from the sprites, so neither the
+        // indexed target nor the static layer mean anything to it.
+        if (state->use_indexed_target && !geometry_buffer) {
+            struct IndexedBuffer* indexed = PushStruct(&state->transient_arena, struct IndexedBuffer);
 
-        StackFree(jobs);
-    }
+            indexed->width  = offscreen_buffer->width;
+            indexed->height = offscreen_buffer->height;
+            indexed->pitch  = (offscreen_buffer->width + 15) & ~15;
+            indexed->pixels = PushArray(&state->transient_arena, u8, indexed->pitch * indexed->height);
 
-    // Draw Mouse cursor
-    {
-        u32 w = 6;
-        u32 h = 6;
-        u32 x = input_state->mouse_x - w / 2;
-        u32 y = input_state->mouse_y - h / 2;
-
-        DrawRect(
-            offscreen_buffer,
-            x, y, w, h,
-            255, 255, 255
+            group->indexed = indexed;
+        }
+
+        // Tiles
+        if (state->use_static_layer && !geometry_buffer) {
+            UpdateStaticLayer(&state->static_layer, &state->tile_map, queue, &state->transient_arena);
+
+            struct StaticLayerPass* static_layer = PushStruct(&state->transient_arena, struct StaticLayerPass);
+
+            static_layer->layer    = &state->static_layer;
+            static_layer->camera_x = state->x_offset;
+            static_layer->camera_y = state->y_offset;
+
+            group->static_layer = static_layer;
+        } else {
+            struct TileMap* map = &state->tile_map;
+
+            i32 first_x = state->x_offset / TILE_SIZE_PIXELS;
+            i32 first_y = state->y_offset / TILE_SIZE_PIXELS;
+            i32 last_x  = Min((i32)(state->x_offset + offscreen_buffer->width)  / TILE_SIZE_PIXELS, (i32)map->width  - 1);
+            i32 last_y  = Min((i32)(state->y_offset + offscreen_buffer->height) / TILE_SIZE_PIXELS, (i32)map->height - 1);
+
+            for (i32 y = first_y; y <= last_y; y += 1) {
+                for (i32 x = first_x; x <= last_x; x += 1) {
+                    enum TileType type = GetTile(map, x, y);
+
+                    PushRect(
+                        group,
+                        SortKey(LayerFloor, 0, 0, type),
+                        x * TILE_SIZE_PIXELS - state->x_offset,
+                        y * TILE_SIZE_PIXELS - state->y_offset,
+                        TILE_SIZE_PIXELS,
+                        TILE_SIZE_PIXELS,
+                        tile_infos[type].colour
+                    );
+                }
+            }
+        }
+
+        // Actors, demons are only drawn when the player can see them.
+        {
+            for (u32 i = 0; i < state->actor_count; i += 1) {
+                struct Actor* actor = &state->actors[i];
+
+                if (i == 0 || CanSee(&player->fov, actor->x, actor->y)) {
+                    bool sees_player = i != 0 && CanSee(&actor->fov, player->x, player->y);
+
+                    u8 colour = (i == 0)    ? ColourPlayer
+                              : sees_player ? ColourDemonHunting
+                              :               ColourDemon;
+
+                    i32 x = actor->x * TILE_SIZE_PIXELS - state->x_offset;
+                    i32 y = actor->y * TILE_SIZE_PIXELS - state->y_offset;
+
+                    struct Rect source = state->frame_table.source[state->animators.frame[actor->animator]];
+
+                    PushImage(
+                        group,
+                        SortKey(LayerActors, y, ACTOR_ATLAS_ID, 0),
+                        x, y, source.w, source.h,
+                        &state->actor_atlas, source.x, source.y,
+                        colour
+                    );
+                }
+            }
+        }
+
+        // The circle drawn on the classroom floor shows through the dark once the
+        // player has seen it.
+        if (CanSee(&player->fov, 104, 40)) {
+            i32 centre_x = 104 * TILE_SIZE_PIXELS + TILE_SIZE_PIXELS / 2 - state->x_offset;
+            i32 centre_y = 40  * TILE_SIZE_PIXELS + TILE_SIZE_PIXELS / 2 - state->y_offset;
+            i32 radius   = TILE_SIZE_PIXELS * 3 / 2;
+            u64 key      = SortKey(LayerEffects, centre_y, 0, 0);
+
+            PushCircle(group, key, centre_x, centre_y, radius, ColourPentagramLine, false);
+
+            i32 points_x[5];
+            i32 points_y[5];
+
+            for (u32 i = 0; i < 5; i += 1) {
+                f32 angle = -0.5f * PI + (f32)i * 2.0f * PI / 5.0f;
+
+                points_x[i] = centre_x + (i32)(cosf(angle) * (radius - 2));
+                points_y[i] = centre_y + (i32)(sinf(angle) * (radius - 2));
+            }
+
+            for (u32 i = 0; i < 5; i += 1) {
+                u32 next = (i + 2) % 5;
+                PushLine(group, key, points_x[i], points_y[i], points_x[next], points_y[next], ColourPentagramLine, true);
+            }
+        }
+
+        // Aim, from the player towards the mouse with a head on the end.
+        {
+            i32 from_x = player->x * TILE_SIZE_PIXELS + TILE_SIZE_PIXELS / 2 - state->x_offset;
+            i32 from_y = player->y * TILE_SIZE_PIXELS + TILE_SIZE_PIXELS / 2 - state->y_offset;
+            i32 to_x   = input_state->mouse_x;
+            i32 to_y   = input_state->mouse_y;
+
+            f32 length = sqrtf((f32)((to_x - from_x) * (to_x - from_x) + (to_y - from_y) * (to_y - from_y)));
+
+            if (length > TILE_SIZE_PIXELS) {
+                f32 direction_x = (to_x - from_x) / length;
+                f32 direction_y = (to_y - from_y) / length;
+                f32 base_x      = to_x - direction_x * 20.0f;
+                f32 base_y      = to_y - direction_y * 20.0f;
+                f32 side_x      = -direction_y * 10.0f;
+                f32 side_y      =  direction_x * 10.0f;
+
+                struct Vertex arrow[3] = {
+                    { to_x,            to_y            },
+                    { base_x + side_x, base_y + side_y },
+                    { base_x - side_x, base_y - side_y },
+                };
+
+                PushLine   (group, SortKey(LayerUI, 0, 0, 0), from_x, from_y, to_x, to_y, ColourWhite, true);
+                PushPolygon(group, SortKey(LayerUI, 0, 0, 0), arrow, ArrayCount(arrow), ColourWhite);
+            }
+        }
+
+        // Minimap, in the top right corner with the player marked on it.
+        if (state->show_minimap) {
+            UpdateMinimap(&state->minimap, &state->tile_map, &player->fov);
+
+            struct SpriteAtlas* image  = &state->minimap.image;
+                   i32          border = 2;
+                   i32          x      = offscreen_buffer->width - image->width - 8 - border;
+                   i32          y      = 8 + border;
+                   u64          key    = SortKey(LayerUI, 0, 0, 0);
+
+            PushRect (group, key, x - border, y - border, image->width + border * 2, image->height + border * 2, ColourBlack);
+            PushImage(group, key, x, y, image->width, image->height, image, 0, 0, ColourBlack);
+            PushRect (
+                group, key,
+                x + player->x * MINIMAP_TILE_PIXELS - 1,
+                y + player->y * MINIMAP_TILE_PIXELS - 1,
+                MINIMAP_TILE_PIXELS + 2,
+                MINIMAP_TILE_PIXELS + 2,
+                ColourPlayer
+            );
+        }
+
+        // Mouse cursor
+        {
+            i32 w = 6;
+            i32 h = 6;
+            i32 x = input_state->mouse_x - w / 2;
+            i32 y = input_state->mouse_y - h / 2;
+
+            PushRect(group, SortKey(LayerUI, y, 0, 0), x, y, w, h, ColourWhite);
+        }
+
+        UpdateLightMap(
+            &state->light_map,
+            &state->tile_map,
+            state->lights,
+            state->light_count,
+            state->lights_version,
+            queue,
+            &state->transient_arena
         );
+
+        struct LightingPass lighting = {
+            .map       = &state->light_map,
+            .camera_x  = state->x_offset,
+            .camera_y  = state->y_offset,
+            .per_pixel = state->per_pixel_lighting,
+        };
+
+        struct ParticlePass particles = {
+            .system   = &state->particles,
+            .camera_x = state->x_offset,
+            .camera_y = state->y_offset,
+        };
+
+        group->lighting  = &lighting;
+        group->particles = &particles;
+
+        if (geometry_buffer) {
+            RenderGroupToGeometry(group, geometry_buffer, offscreen_buffer->width, offscreen_buffer->height, queue, &state->transient_arena);
+        } else {
+            RenderGroupToOutput(group, offscreen_buffer, queue, &state->transient_arena);
+            RunPostProcess(&state->post_process, offscreen_buffer, queue, &state->transient_arena);
+        }
+    }
+}
+
+// ==============================================
+// Audio Script
+// ==============================================
+
+// Behind the wall beside the hallway, in the hallway, in the classroom with the
+// pentagram and out of earshot on the running track.
+static i32 script_spots[SCRIPT_SPOT_COUNT][2] = {
+    { 93, 33 },
+    { 80, 29 },
+    { 104, 40 },
+    { 20, 20 },
+};
+
+// Each update, the listener walks a step of the way from the front gate up the
+// middle hallway and back, while sounds go off around them: hits where they
+// stand, demons at each spot in turn, crowds of pickups to run into the
+// instance limits, and synth sweeps over the hum. Volumes are low enough that
+// the mix rarely clips, which would hide differences from a golden.
+void RunAudioScriptUpdate(struct AudioScript* script, u32 update) {
+    struct Mixer* mixer = &script->mixer;
+
+    u32 step = (update / 15) % 82;
+    i32 x    = 89;
+    i32 y    = (step < 41) ? 70 - (i32)step : 29 + (i32)(step - 41);
+
+    UpdateVisibility(&script->sight, &script->tile_map, x, y);
+    UpdateListener(mixer, &script->tile_map, x, y, &script->sight);
+
+    if (update % 30 == 0) {
+        PlaySoundEvent(mixer, script->sounds, SoundEventHit, 0.25f, x + 0.5f, y + 0.5f);
+    }
+
+    if (update % 45 == 10) {
+        i32* spot = script_spots[(update / 45) % SCRIPT_SPOT_COUNT];
+        PlaySoundEvent(mixer, script->sounds, SoundEventLoss, 0.3f, spot[0] + 0.5f, spot[1] + 0.5f);
     }
+
+    if (update % 100 == 50) {
+        PlaySoundEvent(mixer, script->sounds, SoundEventPowerup, 0.3f, 104.5f, 40.5f);
+    }
+
+    if (update % 240 == 120) {
+        for (i32 i = 0; i < 12; i += 1) {
+            PlaySoundEvent(mixer, script->sounds, SoundEventPickup, 0.15f, x + i % 5 - 1.5f, y + i / 5 + 0.5f);
+        }
+    }
+
+    if (update % 180 == 90) {
+        struct ToneParams sweep = {
+            .waveform     = WaveformSquare,
+            .frequency    = 220.0f,
+            .slide        = 660.0f,
+            .volume       = 0.08f,
+            .pan          = -0.5f,
+            .envelope     = { .attack = 0.01f, .decay = 0.1f, .sustain = 0.6f, .release = 0.2f },
+            .hold_seconds = 0.3f,
+        };
+
+        PlayTone(&script->synth, &sweep);
+    }
+}
+
+// The audio script has its own memory rather than the game's, so starting it
+// is always the same. Returns how long the mixing took, leaving out loading and
+// the script itself, for benchmarking.
+f32 RenderAudioScript(struct Memory* memory, struct AudioBuffer* audio_buffer) {
+    struct AudioScript* script = (struct AudioScript*)memory->permanent;
+
+    InitArena(
+        &script->permanent_arena,
+        (u8*)memory->permanent + sizeof(struct AudioScript),
+        memory->permanent_size - sizeof(struct AudioScript)
+    );
+
+    u32 samples_per_second = audio_buffer->samples_per_second;
+
+    GenerateSchool(&script->tile_map, &script->permanent_arena);
+    InitVisibility(&script->sight, 12, &script->permanent_arena);
+
+    InitMixer(&script->mixer, samples_per_second, &script->permanent_arena);
+    LoadSoundAssets(script->sounds, samples_per_second, &script->permanent_arena);
+
+    InitSynth(&script->synth, samples_per_second);
+    script->mixer.synth = &script->synth;
+
+    struct ToneParams hum = {
+        .waveform  = WaveformSine,
+        .frequency = 256.0f,
+        .volume    = 0.13f,
+        .envelope  = { .attack = 0.05f, .sustain = 1.0f },
+    };
+
+    PlayTone(&script->synth, &hum);
+
+    u32 frame_count       = audio_buffer->samples_size / audio_buffer->bytes_per_sample;
+    u32 frames_per_update = samples_per_second / SCRIPT_UPDATES_PER_SECOND;
+    f32 mixing_seconds    = 0.0f;
+
+    for (u32 update = 0, frame = 0; frame < frame_count; update += 1) {
+        InitArena(&script->transient_arena, memory->transient, memory->transient_size);
+
+        struct AudioBuffer block = {
+            .samples            = (u16*)((u8*)audio_buffer->samples + frame * audio_buffer->bytes_per_sample),
+            .samples_size       = Min(frames_per_update, frame_count - frame) * audio_buffer->bytes_per_sample,
+            .samples_per_second = samples_per_second,
+            .bytes_per_sample   = audio_buffer->bytes_per_sample,
+        };
+
+        RunAudioScriptUpdate(script, update);
+
+        u64 begin = GetWallClock();
+        MixAudio(&script->mixer, &block, &script->transient_arena);
+        mixing_seconds += GetSecondsElapsed(begin, GetWallClock());
+
+        frame += block.samples_size / block.bytes_per_sample;
+    }
+
+    return(mixing_seconds);
 }
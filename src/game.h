@@ -25,17 +25,141 @@ enum TileType {
     PentagramBR,
     StreetFloor0,
     StreetFloor1,
+    Wall,
+
+    TileTypeCount,
+};
+
+#define TILE_SIZE_PIXELS 32
+
+enum TileFlags {
+    TileBlocksSight = 1 << 0,
+};
+
+struct TileInfo {
+    enum PaletteColour colour;
+         u32           flags;
+};
+
+// Must be a power of two.
+#define TILE_CHANGE_LOG_SIZE 64
+
+struct TileChange {
+    i32 x;
+    i32 y;
 };
 
 struct TileMap {
-         u32       width;
-         u32       height;
-    enum TileType* tiles;
+           u32        width;
+           u32        height;
+      enum TileType*  tiles;
+
+    // Bumped every time a tile changes so that anything derived from the map
+    // can tell when it is out of date.
+           u32        version;
+
+    // The most recent changes to whether a tile blocks sight. The count keeps
+    // going up, it is only wrapped when indexing into the log.
+           u32        blocking_change_count;
+    struct TileChange blocking_changes[TILE_CHANGE_LOG_SIZE];
+
+    // The same again for every change, for things that only care about what a
+    // tile looks like.
+           u32        change_count;
+    struct TileChange changes[TILE_CHANGE_LOG_SIZE];
+};
+
+#define MAX_SPRITES_PER_FRAME 65536
+
+#define MAX_LIGHTS  256
+#define MAX_ACTORS  256
+#define DEMON_COUNT 200
+
+// The visibility jobs are all pushed before any are waited on, and the job
+// queue only holds 256 entries.
+#define MAX_VISIBILITY_JOBS 64
+
+// How many frames a movement key has to be held before the next turn is taken.
+#define TURN_REPEAT_FRAMES  8
+#define DAMAGE_FLASH_FRAMES 12
+
+struct Actor {
+           i32               x;
+           i32               y;
+    struct Visibility        fov;
+      enum AnimationSet      animation_set;
+      enum Facing            facing;
+           u32               animator;
 };
 
 struct GameState {
-           bool    initialised;
-           u32     x_offset;
-           u32     y_offset;
-    struct Locale* locale;
+           bool            initialised;
+           u32             x_offset;
+           u32             y_offset;
+    struct Locale*         locale;
+    struct MemoryArena     permanent_arena;
+    struct MemoryArena     transient_arena;
+
+    struct TileMap         tile_map;
+
+    // The player is always the first actor.
+    struct Actor           actors[MAX_ACTORS];
+           u32             actor_count;
+           u32             turn_cooldown;
+           u32             random_state;
+
+    struct Light           lights[MAX_LIGHTS];
+           u32             light_count;
+           u32             lights_version;
+    struct LightMap        light_map;
+           bool            per_pixel_lighting;
+
+           bool            use_indexed_target;
+    struct Palette         palette;
+           u32             damage_flash;
+
+    struct ParticleSystem  particles;
+
+    struct StaticLayer     static_layer;
+           bool            use_static_layer;
+
+    struct Minimap         minimap;
+           bool            show_minimap;
+
+    struct PostProcess     post_process;
+
+    struct TileLayoutCache tile_layouts;
+
+    struct SpriteAtlas     actor_atlas;
+    struct FrameTable      frame_table;
+    struct Animators       animators;
+
+    struct Mixer           mixer;
+    struct Synth           synth;
+    struct MusicStream     music;
+    struct Sound           sounds[SoundAssetCount];
+};
+
+// ==============================================
+// Audio Script
+// ==============================================
+
+// Updates the script takes a second, each mixing one block like a frame of the
+// game would.
+#define SCRIPT_UPDATES_PER_SECOND 60
+
+// Sounds are scripted to a tile. Demons take turns making noise at these.
+#define SCRIPT_SPOT_COUNT 4
+
+// Everything the audio script needs, kept in the permanent block of its own
+// memory in place of a GameState.
+struct AudioScript {
+    struct MemoryArena permanent_arena;
+    struct MemoryArena transient_arena;
+
+    struct TileMap     tile_map;
+    struct Visibility  sight;
+    struct Mixer       mixer;
+    struct Synth       synth;
+    struct Sound       sounds[SoundAssetCount];
 };
@@ -0,0 +1,384 @@
+// ==============================================
+// Geometry
+// ==============================================
+
+// Circles become polygons with up to this many sides, fewer for small ones.
+#define MAX_CIRCLE_SEGMENTS 64
+
+u32 CircleSegments(i32 radius) {
+    return(Clamp(radius * 2, 8, MAX_CIRCLE_SEGMENTS));
+}
+
+// What the vertices of the sprite being converted are coloured with.
+struct GeometryTarget {
+    struct GeometryBuffer* buffer;
+    struct LightingPass*   lighting; // NULL when the sprite isn't lit.
+           u32             colour;   // ARGB.
+
+    // Where the light is sampled when lighting isn't per pixel, so the whole
+    // sprite gets one light like it does in software.
+           i32             centre_x;
+           i32             centre_y;
+};
+
+u32 GeometryVertexColour(struct GeometryTarget* target, f32 x, f32 y) {
+    u32 colour = target->colour | 0xFF000000;
+
+    if (target->lighting) {
+        u32 light = target->lighting->per_pixel
+                  ? SampleLight(target->lighting, (i32)x, (i32)y)
+                  : SampleLight(target->lighting, target->centre_x, target->centre_y);
+
+        colour = MultiplyLight(colour, light);
+    }
+
+    // Packed ABGR is RGBA byte order on the little endian machines we run on.
+    return(ConvertColour(colour, PixelFormatABGR8888));
+}
+
+// Starts a new batch unless the last one already draws the same way.
+void UseGeometryBatch(struct GeometryBuffer* buffer, struct GeometryTexture* texture, enum GeometryBlend blend) {
+    struct GeometryBatch* last = buffer->batch_count ? &buffer->batches[buffer->batch_count - 1] : NULL;
+
+    if (!last || last->texture != texture || last->blend != blend) {
+        struct GeometryBatch* batch = &buffer->batches[buffer->batch_count++];
+
+        batch->texture     = texture;
+        batch->blend       = blend;
+        batch->first_index = buffer->index_count;
+        batch->index_count = 0;
+    }
+}
+
+i32 AddGeometryVertex(struct GeometryTarget* target, f32 x, f32 y, f32 u, f32 v) {
+    struct GeometryBuffer* buffer = target->buffer;
+    i32                    index  = buffer->vertex_count++;
+
+    buffer->vertices[index] = (struct GeometryVertex){ x, y, GeometryVertexColour(target, x, y), u, v };
+
+    return(index);
+}
+
+void AddGeometryTriangle(struct GeometryBuffer* buffer, i32 a, i32 b, i32 c) {
+    buffer->indices[buffer->index_count++] = a;
+    buffer->indices[buffer->index_count++] = b;
+    buffer->indices[buffer->index_count++] = c;
+
+    buffer->batches[buffer->batch_count - 1].index_count += 3;
+}
+
+// Corners go round the edge in order.
+void AddGeometryQuad(struct GeometryTarget* target, struct Vertex* corners, struct Vertex* uvs) {
+    i32 first = target->buffer->vertex_count;
+
+    for (u32 i = 0; i < 4; i += 1) {
+        AddGeometryVertex(target, corners[i].x, corners[i].y, uvs[i].x, uvs[i].y);
+    }
+
+    AddGeometryTriangle(target->buffer, first + 0, first + 1, first + 2);
+    AddGeometryTriangle(target->buffer, first + 0, first + 2, first + 3);
+}
+
+void AddGeometryRect(struct GeometryTarget* target, f32 x0, f32 y0, f32 x1, f32 y1, f32 u0, f32 v0, f32 u1, f32 v1) {
+    struct Vertex corners[4] = { { x0, y0 }, { x1, y0 }, { x1, y1 }, { x0, y1 } };
+    struct Vertex uvs    [4] = { { u0, v0 }, { u1, v0 }, { u1, v1 }, { u0, v1 } };
+
+    AddGeometryQuad(target, corners, uvs);
+}
+
+// ==============================================
+// Atlases
+
+// Re-expands the atlas through the palette when either has changed since the
+// platform was last given it.
+void UpdateAtlasTexture(struct SpriteAtlas* atlas, struct Palette* palette) {
+    bool is_stale = atlas->texture_atlas_version != atlas->version
+                 || memcmp(atlas->texture_palette, palette->colours, sizeof(atlas->texture_palette)) != 0;
+
+    if (is_stale) {
+        struct GeometryTexture* texture = &atlas->texture;
+
+        for (i32 y = 0; y < atlas->height; y += 1) {
+            u8*  source = atlas->pixels  + y * atlas->pitch;
+            u32* detail = texture->pixels + y * texture->width;
+            u32* body   = detail + atlas->width;
+
+            for (i32 x = 0; x < atlas->width; x += 1) {
+                u8 index = source[x];
+
+                detail[x] = (index == ATLAS_TRANSPARENT || index == ATLAS_BODY)
+                          ? 0
+                          : ConvertColour(palette->colours[index] | 0xFF000000, PixelFormatABGR8888);
+                body  [x] = (index == ATLAS_BODY) ? 0xFFFFFFFF : 0;
+            }
+        }
+
+        memcpy(atlas->texture_palette, palette->colours, sizeof(atlas->texture_palette));
+
+        atlas->texture_atlas_version = atlas->version;
+        texture->version            += 1;
+    }
+}
+
+// ==============================================
+// Sprites
+
+void CountSpriteGeometry(struct Sprite* sprite, u32* vertex_count, u32* index_count) {
+    switch (sprite->kind) {
+        case SpriteRect:
+        case SpriteLine: {
+            *vertex_count += 4;
+            *index_count  += 6;
+        } break;
+
+        case SpriteCircle: {
+            u32 segments = CircleSegments(sprite->shape.circle.radius);
+
+            if (sprite->flags & SpriteFilled) {
+                *vertex_count += segments + 1;
+                *index_count  += segments * 3;
+            } else {
+                *vertex_count += segments * 2;
+                *index_count  += segments * 6;
+            }
+        } break;
+
+        case SpritePolygon: {
+            *vertex_count +=  sprite->shape.polygon.count;
+            *index_count  += (sprite->shape.polygon.count - 2) * 3;
+        } break;
+
+        case SpriteImage: {
+            *vertex_count += 8;
+            *index_count  += 12;
+        } break;
+    }
+}
+
+// Pixels are covered when their centres are inside a shape, which is the rule
+// the GPU fills triangles by as well, so the shapes are built around the
+// centres of the pixels the software path would touch.
+void AddSpriteGeometry(struct GeometryTarget* target, struct Sprite* sprite) {
+    struct GeometryBuffer* buffer = target->buffer;
+
+    if (sprite->kind != SpriteImage) {
+        UseGeometryBatch(buffer, NULL, GeometryBlendAlpha);
+    }
+
+    switch (sprite->kind) {
+        case SpriteRect: {
+            AddGeometryRect(target, sprite->x, sprite->y, sprite->x + sprite->w, sprite->y + sprite->h, 0.0f, 0.0f, 0.0f, 0.0f);
+        } break;
+
+        // A pixel wide quad from the centre of one end pixel to the other, with
+        // half a pixel added all round so the ends are covered.
+        case SpriteLine: {
+            f32 x0 = sprite->shape.line.x0 + 0.5f;
+            f32 y0 = sprite->shape.line.y0 + 0.5f;
+            f32 x1 = sprite->shape.line.x1 + 0.5f;
+            f32 y1 = sprite->shape.line.y1 + 0.5f;
+
+            f32 length  = sqrtf((x1 - x0) * (x1 - x0) + (y1 - y0) * (y1 - y0));
+            f32 along_x = (length > 0.0f) ? (x1 - x0) / length * 0.5f : 0.5f;
+            f32 along_y = (length > 0.0f) ? (y1 - y0) / length * 0.5f : 0.0f;
+
+            struct Vertex corners[4] = {
+                { x0 - along_x - along_y, y0 - along_y + along_x },
+                { x1 + along_x - along_y, y1 + along_y + along_x },
+                { x1 + along_x + along_y, y1 + along_y - along_x },
+                { x0 - along_x + along_y, y0 - along_y - along_x },
+            };
+            struct Vertex uvs[4] = {};
+
+            AddGeometryQuad(target, corners, uvs);
+        } break;
+
+        case SpriteCircle: {
+            f32 centre_x = sprite->shape.circle.x + 0.5f;
+            f32 centre_y = sprite->shape.circle.y + 0.5f;
+            f32 outer    = sprite->shape.circle.radius + 0.5f;
+            f32 inner    = sprite->shape.circle.radius - 0.5f;
+            u32 segments = CircleSegments(sprite->shape.circle.radius);
+
+            if (sprite->flags & SpriteFilled) {
+                i32 centre = AddGeometryVertex(target, centre_x, centre_y, 0.0f, 0.0f);
+
+                for (u32 i = 0; i < segments; i += 1) {
+                    f32 angle = (f32)i * 2.0f * PI / (f32)segments;
+                    AddGeometryVertex(target, centre_x + cosf(angle) * outer, centre_y + sinf(angle) * outer, 0.0f, 0.0f);
+                }
+
+                for (u32 i = 0; i < segments; i += 1) {
+                    AddGeometryTriangle(buffer, centre, centre + 1 + i, centre + 1 + (i + 1) % segments);
+                }
+            } else {
+                i32 first = buffer->vertex_count;
+
+                for (u32 i = 0; i < segments; i += 1) {
+                    f32 angle = (f32)i * 2.0f * PI / (f32)segments;
+                    AddGeometryVertex(target, centre_x + cosf(angle) * outer, centre_y + sinf(angle) * outer, 0.0f, 0.0f);
+                    AddGeometryVertex(target, centre_x + cosf(angle) * inner, centre_y + sinf(angle) * inner, 0.0f, 0.0f);
+                }
+
+                for (u32 i = 0; i < segments; i += 1) {
+                    i32 outer_a = first + i * 2;
+                    i32 outer_b = first + ((i + 1) % segments) * 2;
+
+                    AddGeometryTriangle(buffer, outer_a,     outer_b, outer_a + 1);
+                    AddGeometryTriangle(buffer, outer_a + 1, outer_b, outer_b + 1);
+                }
+            }
+        } break;
+
+        // Convex, so a fan from the first vertex covers it.
+        case SpritePolygon: {
+            struct Vertex* vertices = sprite->shape.polygon.vertices;
+                   u32     count    = sprite->shape.polygon.count;
+                   i32     first    = buffer->vertex_count;
+
+            for (u32 i = 0; i < count; i += 1) {
+                AddGeometryVertex(target, vertices[i].x, vertices[i].y, 0.0f, 0.0f);
+            }
+
+            for (u32 i = 1; i + 1 < count; i += 1) {
+                AddGeometryTriangle(buffer, first, first + i, first + i + 1);
+            }
+        } break;
+
+        // The body in the sprite's colour, then the details over the top of it.
+        case SpriteImage: {
+            struct SpriteAtlas*     atlas   = sprite->shape.image.atlas;
+            struct GeometryTexture* texture = &atlas->texture;
+
+            UseGeometryBatch(buffer, texture, GeometryBlendAlpha);
+
+            f32 u0   = (f32)(sprite->shape.image.x)             / (f32)texture->width;
+            f32 u1   = (f32)(sprite->shape.image.x + sprite->w) / (f32)texture->width;
+            f32 v0   = (f32)(sprite->shape.image.y)             / (f32)texture->height;
+            f32 v1   = (f32)(sprite->shape.image.y + sprite->h) / (f32)texture->height;
+            f32 body = (f32)atlas->width / (f32)texture->width;
+
+            f32 x0 = sprite->x;
+            f32 y0 = sprite->y;
+            f32 x1 = sprite->x + sprite->w;
+            f32 y1 = sprite->y + sprite->h;
+
+            AddGeometryRect(target, x0, y0, x1, y1, u0 + body, v0, u1 + body, v1);
+
+            target->colour = 0xFFFFFFFF;
+            AddGeometryRect(target, x0, y0, x1, y1, u0, v0, u1, v1);
+        } break;
+    }
+}
+
+void AddParticleGeometry(struct GeometryBuffer* buffer, struct ParticlePass* pass, struct Rect screen) {
+    struct ParticleSystem* system = pass->system;
+    struct GeometryTarget  target = { .buffer = buffer };
+
+    f32 fade_scale = 1.0f / system->fade_seconds;
+
+    UseGeometryBatch(buffer, NULL, GeometryBlendAdd);
+
+    for (u32 i = 0; i < system->count; i += 1) {
+        i32 x = (i32)system->x[i] - pass->camera_x;
+        i32 y = (i32)system->y[i] - pass->camera_y;
+
+        if (x + PARTICLE_SIZE_PIXELS > screen.x && x < screen.x + screen.w &&
+            y + PARTICLE_SIZE_PIXELS > screen.y && y < screen.y + screen.h) {
+            target.colour = FadedParticleColour(system, i, fade_scale);
+
+            AddGeometryRect(&target, x, y, x + PARTICLE_SIZE_PIXELS, y + PARTICLE_SIZE_PIXELS, 0.0f, 0.0f, 0.0f, 0.0f);
+        }
+    }
+}
+
+// The same frame RenderGroupToOutput would draw, as batches of triangles for
+// the platform to draw. Lighting is sampled at the vertices and blended across
+// the triangles, and there is no indexed target, static layer or post
+// processing; the floor is expected to be pushed as sprites instead.
+void RenderGroupToGeometry(
+    struct RenderGroup*    group,
+    struct GeometryBuffer* buffer,
+           i32             width,
+           i32             height,
+    struct JobQueue*       queue,
+    struct MemoryArena*    arena
+) {
+    struct SortEntry* scratch = PushArray(arena, struct SortEntry, group->count);
+    struct SortEntry* sorted  = RadixSort(group->entries, scratch, group->count, queue, arena);
+
+    struct Rect screen = { 0, 0, width, height };
+
+    // Sized up front so nothing has to grow as it's filled in. Every sprite can
+    // need at most two batches, one for itself and one for the particles that
+    // might go in before it.
+    u32 vertex_capacity = 0;
+    u32 index_capacity  = 0;
+    u32 batch_capacity  = 1;
+
+    struct SpriteAtlas* updated_atlas = NULL;
+
+    for (u32 i = 0; i < group->count; i += 1) {
+        struct Sprite* sprite = &group->sprites[sorted[i].index];
+        struct Rect    visible;
+
+        if (IntersectRect(screen, (struct Rect){ sprite->x, sprite->y, sprite->w, sprite->h }, &visible)) {
+            CountSpriteGeometry(sprite, &vertex_capacity, &index_capacity);
+            batch_capacity += 2;
+
+            // Sprites from the same atlas tend to come in runs, so checking
+            // against the last one skips most of the palette compares.
+            if (sprite->kind == SpriteImage && sprite->shape.image.atlas != updated_atlas) {
+                updated_atlas = sprite->shape.image.atlas;
+                UpdateAtlasTexture(updated_atlas, group->palette);
+            }
+        }
+    }
+
+    if (group->particles) {
+        vertex_capacity += group->particles->system->count * 4;
+        index_capacity  += group->particles->system->count * 6;
+    }
+
+    buffer->clear_colour = group->palette->colours[group->clear_colour];
+    buffer->vertices     = PushArray(arena, struct GeometryVertex, vertex_capacity);
+    buffer->vertex_count = 0;
+    buffer->indices      = PushArray(arena, i32, index_capacity);
+    buffer->index_count  = 0;
+    buffer->batches      = PushArray(arena, struct GeometryBatch, batch_capacity);
+    buffer->batch_count  = 0;
+
+    // Particles glow, so like in software they go on after the lit layers.
+    bool particles_added = group->particles == NULL;
+
+    for (u32 i = 0; i < group->count; i += 1) {
+        struct Sprite* sprite = &group->sprites[sorted[i].index];
+        bool           is_lit = SortKeyLayer(sorted[i].key) < LayerEffects;
+        struct Rect    visible;
+
+        if (!is_lit && !particles_added) {
+            AddParticleGeometry(buffer, group->particles, screen);
+            particles_added = true;
+        }
+
+        if (IntersectRect(screen, (struct Rect){ sprite->x, sprite->y, sprite->w, sprite->h }, &visible)) {
+            struct GeometryTarget target = {
+                .buffer   = buffer,
+                .lighting = is_lit ? group->lighting : NULL,
+                .colour   = group->palette->colours[sprite->colour],
+                .centre_x = sprite->x + sprite->w / 2,
+                .centre_y = sprite->y + sprite->h / 2,
+            };
+
+            AddSpriteGeometry(&target, sprite);
+        }
+    }
+
+    if (!particles_added) {
+        AddParticleGeometry(buffer, group->particles, screen);
+    }
+
+    Assert(buffer->vertex_count <= vertex_capacity);
+    Assert(buffer->index_count  <= index_capacity);
+    Assert(buffer->batch_count  <= batch_capacity);
+}
@@ -0,0 +1,383 @@
+// ==============================================
+// Lighting
+// ==============================================
+
+void InitLightMap(struct LightMap* light_map, struct TileMap* tile_map, struct MemoryArena* arena, u32 ambient) {
+    light_map->width    = tile_map->width;
+    light_map->height   = tile_map->height;
+    light_map->light    = PushArray(arena, u32, tile_map->width * tile_map->height);
+    light_map->ambient  = ambient;
+    light_map->is_valid = false;
+}
+
+// ==============================================
+// Building the light map
+
+// Each light is shadowcast into its own square patch of falloff values. The
+// patches are then summed into the map a band of rows at a time, so no two jobs
+// ever write to the same place.
+struct LightPatch {
+    struct Light* light;
+           u8*    falloff;
+           i32    size;
+};
+
+struct LightPatchJob {
+    struct TileMap*    tile_map;
+    struct LightPatch* patches;
+           u32         count;
+};
+
+void VisitLitTile(void* data, i32 x, i32 y) {
+    struct LightPatch* patch = (struct LightPatch*)data;
+    struct Light*      light = patch->light;
+
+    i32 dx = x - light->x;
+    i32 dy = y - light->y;
+
+    // Quadratic falloff, 1 at the light and 0 at its radius.
+    f32 distance_squared = (f32)(dx * dx + dy * dy);
+    f32 radius_squared   = (f32)(light->radius * light->radius);
+    f32 falloff          = Clamp(1.0f - distance_squared / radius_squared, 0.0f, 1.0f);
+
+    patch->falloff[(dx + light->radius) + (dy + light->radius) * patch->size] = (u8)(falloff * 255.0f);
+}
+
+void ThreadCastLights(void* data) {
+    struct LightPatchJob* job = (struct LightPatchJob*)data;
+
+    for (u32 i = 0; i < job->count; i += 1) {
+        struct LightPatch* patch = &job->patches[i];
+        struct Light*      light = patch->light;
+
+        memset(patch->falloff, 0, patch->size * patch->size);
+        CastShadows(job->tile_map, light->x, light->y, light->radius, VisitLitTile, patch);
+    }
+}
+
+struct LightBandJob {
+    struct LightMap*   light_map;
+    struct LightPatch* patches;
+           u32         patch_count;
+           u32         min_y;
+           u32         max_y;
+           u32*        accumulator;
+};
+
+void ThreadAccumulateLights(void* data) {
+    struct LightBandJob* job       = (struct LightBandJob*)data;
+    struct LightMap*     light_map = job->light_map;
+
+    u32  width       = light_map->width;
+    u32  band_height = job->max_y - job->min_y;
+    u32* accumulator = job->accumulator;
+
+    u32 ambient_r = (light_map->ambient >> 16) & 0xFF;
+    u32 ambient_g = (light_map->ambient >>  8) & 0xFF;
+    u32 ambient_b = (light_map->ambient >>  0) & 0xFF;
+
+    for (u32 i = 0; i < width * band_height; i += 1) {
+        accumulator[i * 3 + 0] = ambient_r * 255;
+        accumulator[i * 3 + 1] = ambient_g * 255;
+        accumulator[i * 3 + 2] = ambient_b * 255;
+    }
+
+    for (u32 i = 0; i < job->patch_count; i += 1) {
+        struct LightPatch* patch = &job->patches[i];
+        struct Light*      light = patch->light;
+
+        i32 patch_x = light->x - light->radius;
+        i32 patch_y = light->y - light->radius;
+
+        i32 min_x = Max(patch_x, 0);
+        i32 max_x = Min(patch_x + patch->size, (i32)width);
+        i32 min_y = Max(patch_y, (i32)job->min_y);
+        i32 max_y = Min(patch_y + patch->size, (i32)job->max_y);
+
+        u32 r = (light->colour >> 16) & 0xFF;
+        u32 g = (light->colour >>  8) & 0xFF;
+        u32 b = (light->colour >>  0) & 0xFF;
+
+        for (i32 y = min_y; y < max_y; y += 1) {
+            u8*  falloff = patch->falloff + (min_x - patch_x) + (y - patch_y) * patch->size;
+            u32* sum     = accumulator + (min_x + (y - job->min_y) * width) * 3;
+
+            for (i32 x = min_x; x < max_x; x += 1) {
+                u32 amount = *falloff++;
+
+                sum[0] += r * amount;
+                sum[1] += g * amount;
+                sum[2] += b * amount;
+                sum    += 3;
+            }
+        }
+    }
+
+    u32* light = light_map->light + job->min_y * width;
+
+    for (u32 i = 0; i < width * band_height; i += 1) {
+        u32 r = Min(accumulator[i * 3 + 0] / 255, 255);
+        u32 g = Min(accumulator[i * 3 + 1] / 255, 255);
+        u32 b = Min(accumulator[i * 3 + 2] / 255, 255);
+
+        light[i] = ARGB(0xFF, r, g, b);
+    }
+}
+
+// Rebuilds the light map if the tiles or the lights have changed since it was last built.
+void UpdateLightMap(
+    struct LightMap*    light_map,
+    struct TileMap*     tile_map,
+    struct Light*       lights,
+           u32          light_count,
+           u32          lights_version,
+    struct JobQueue*    queue,
+    struct MemoryArena* arena
+) {
+    bool is_up_to_date = light_map->is_valid
+                      && light_map->tile_map_version == tile_map->version
+                      && light_map->lights_version   == lights_version;
+
+    if (!is_up_to_date) {
+        struct LightPatch* patches = PushArray(arena, struct LightPatch, light_count);
+
+        for (u32 i = 0; i < light_count; i += 1) {
+            struct LightPatch* patch = &patches[i];
+
+            patch->light   = &lights[i];
+            patch->size    = lights[i].radius * 2 + 1;
+            patch->falloff = PushArray(arena, u8, patch->size * patch->size);
+        }
+
+        u32 cast_job_count = Min(light_count,       Min(CpuCoreCount(queue) * 4, MAX_LIGHT_JOBS));
+        u32 band_job_count = Min(light_map->height, Min(CpuCoreCount(queue) * 2, MAX_LIGHT_JOBS));
+
+        struct LightPatchJob* cast_jobs = PushArray(arena, struct LightPatchJob, cast_job_count);
+        struct LightBandJob*  band_jobs = PushArray(arena, struct LightBandJob,  band_job_count);
+
+        for (u32 i = 0; i < cast_job_count; i += 1) {
+            u32 first = light_count *  i      / cast_job_count;
+            u32 last  = light_count * (i + 1) / cast_job_count;
+
+            cast_jobs[i].tile_map = tile_map;
+            cast_jobs[i].patches  = patches + first;
+            cast_jobs[i].count    = last - first;
+
+            PushJob(queue, &cast_jobs[i], ThreadCastLights);
+        }
+
+        CompleteRemainingWork(queue);
+
+        for (u32 i = 0; i < band_job_count; i += 1) {
+            struct LightBandJob* job = &band_jobs[i];
+
+            job->light_map   = light_map;
+            job->patches     = patches;
+            job->patch_count = light_count;
+            job->min_y       = light_map->height *  i      / band_job_count;
+            job->max_y       = light_map->height * (i + 1) / band_job_count;
+            job->accumulator = PushArray(arena, u32, light_map->width * (job->max_y - job->min_y) * 3);
+
+            PushJob(queue, job, ThreadAccumulateLights);
+        }
+
+        CompleteRemainingWork(queue);
+
+        light_map->is_valid         = true;
+        light_map->tile_map_version = tile_map->version;
+        light_map->lights_version   = lights_version;
+    }
+}
+
+// ==============================================
+// Applying the light map
+
+u32 LightAt(struct LightMap* light_map, i32 x, i32 y) {
+    x = Clamp(x, 0, (i32)light_map->width  - 1);
+    y = Clamp(y, 0, (i32)light_map->height - 1);
+
+    return(light_map->light[x + y * light_map->width]);
+}
+
+// Blends two packed lights, t is out of TILE_SIZE_PIXELS. Every channel is
+// blended the same way, so it works whichever format the lights are in.
+u32 LerpLight(u32 a, u32 b, i32 t) {
+    u32 result = 0;
+
+    for (u32 shift = 0; shift < 32; shift += 8) {
+        i32 from = (a >> shift) & 0xFF;
+        i32 to   = (b >> shift) & 0xFF;
+
+        result |= (u32)(from + (to - from) * t / TILE_SIZE_PIXELS) << shift;
+    }
+
+    return(result);
+}
+
+// Multiplies the channels of four pixels by the matching 16 bit lights, where
+// 256 leaves a channel untouched.
+__m128i MultiplyLight4(__m128i pixels, __m128i light_lo, __m128i light_hi) {
+    __m128i zero = _mm_setzero_si128();
+    __m128i lo   = _mm_unpacklo_epi8(pixels, zero);
+    __m128i hi   = _mm_unpackhi_epi8(pixels, zero);
+
+    lo = _mm_srli_epi16(_mm_mullo_epi16(lo, light_lo), 8);
+    hi = _mm_srli_epi16(_mm_mullo_epi16(hi, light_hi), 8);
+
+    return(_mm_packus_epi16(lo, hi));
+}
+
+u32 MultiplyLight(u32 pixel, u32 light) {
+    u32 result = 0;
+
+    for (u32 shift = 0; shift < 32; shift += 8) {
+        u32 channel = (pixel >> shift) & 0xFF;
+        u32 amount  = ((light >> shift) & 0xFF) + 1;
+
+        result |= ((channel * amount) >> 8) << shift;
+    }
+
+    return(result);
+}
+
+// Every pixel of a tile gets the same light, so each row is a handful of
+// constant spans.
+void ApplyTileLighting(struct OffscreenBuffer* buffer, struct Rect clip, struct LightingPass* pass) {
+    __m128i zero = _mm_setzero_si128();
+    __m128i one  = _mm_set1_epi16(1);
+
+    for (i32 y = clip.y; y < clip.y + clip.h; y += 1) {
+        i32  tile_y = FloorDiv(y + pass->camera_y, TILE_SIZE_PIXELS);
+        u32* row    = (u32*)((u8*)buffer->pixels + y * buffer->pitch);
+        i32  x      = clip.x;
+
+        while (x < clip.x + clip.w) {
+            i32 tile_x   = FloorDiv(x + pass->camera_x, TILE_SIZE_PIXELS);
+            i32 span_end = Min((tile_x + 1) * TILE_SIZE_PIXELS - pass->camera_x, clip.x + clip.w);
+
+            u32     light    = ConvertColour(LightAt(pass->map, tile_x, tile_y), buffer->format);
+            __m128i light_16 = _mm_add_epi16(_mm_unpacklo_epi8(_mm_set1_epi32(light), zero), one);
+
+            for (; x + 4 <= span_end; x += 4) {
+                __m128i* pixels = (__m128i*)(row + x);
+                _mm_storeu_si128(pixels, MultiplyLight4(_mm_loadu_si128(pixels), light_16, light_16));
+            }
+
+            for (; x < span_end; x += 1) {
+                row[x] = MultiplyLight(row[x], light);
+            }
+        }
+    }
+}
+
+// The light of each tile is treated as a sample at its centre and blended
+// bilinearly in between. Vertical blending is done once per tile column per row,
+// horizontal blending four pixels at a time in 16 bit fixed point.
+void ApplyPixelLighting(struct OffscreenBuffer* buffer, struct Rect clip, struct LightingPass* pass) {
+    i32 half_tile = TILE_SIZE_PIXELS / 2;
+
+    i32 first_column = FloorDiv(clip.x + pass->camera_x - half_tile, TILE_SIZE_PIXELS);
+    i32 last_column  = FloorDiv(clip.x + clip.w + pass->camera_x - half_tile, TILE_SIZE_PIXELS) + 1;
+    i32 column_count = last_column - first_column + 1;
+
+    // Enough columns for a screen tile 8192 pixels wide.
+    u32 row_lights[256];
+    Assert(column_count <= (i32)ArrayCount(row_lights));
+
+    __m128i zero = _mm_setzero_si128();
+    __m128i one  = _mm_set1_epi16(1);
+    __m128i four = _mm_set1_epi16(4);
+
+    for (i32 y = clip.y; y < clip.y + clip.h; y += 1) {
+        i32 world_y = y + pass->camera_y - half_tile;
+        i32 tile_y  = FloorDiv(world_y, TILE_SIZE_PIXELS);
+        i32 t_y     = world_y - tile_y * TILE_SIZE_PIXELS;
+
+        for (i32 i = 0; i < column_count; i += 1) {
+            i32 tile_x = first_column + i;
+            row_lights[i] = ConvertColour(
+                LerpLight(LightAt(pass->map, tile_x, tile_y), LightAt(pass->map, tile_x, tile_y + 1), t_y),
+                buffer->format
+            );
+        }
+
+        u32* row = (u32*)((u8*)buffer->pixels + y * buffer->pitch);
+        i32  x   = clip.x;
+
+        while (x < clip.x + clip.w) {
+            i32 world_x  = x + pass->camera_x - half_tile;
+            i32 tile_x   = FloorDiv(world_x, TILE_SIZE_PIXELS);
+            i32 t_x      = world_x - tile_x * TILE_SIZE_PIXELS;
+            i32 span_end = Min(x + (TILE_SIZE_PIXELS - t_x), clip.x + clip.w);
+
+            u32 light_a = row_lights[tile_x     - first_column];
+            u32 light_b = row_lights[tile_x + 1 - first_column];
+
+            __m128i from  = _mm_unpacklo_epi8(_mm_set1_epi32(light_a), zero);
+            __m128i to    = _mm_unpacklo_epi8(_mm_set1_epi32(light_b), zero);
+            __m128i delta = _mm_sub_epi16(to, from);
+
+            // Lanes 0-3 hold the channels of the first pixel of a pair and lanes
+            // 4-7 the second, so t advances by one between the halves.
+            __m128i t_lo = _mm_set_epi16(t_x + 1, t_x + 1, t_x + 1, t_x + 1, t_x + 0, t_x + 0, t_x + 0, t_x + 0);
+            __m128i t_hi = _mm_set_epi16(t_x + 3, t_x + 3, t_x + 3, t_x + 3, t_x + 2, t_x + 2, t_x + 2, t_x + 2);
+
+            for (; x + 4 <= span_end; x += 4) {
+                // The delta is at most 255 in magnitude and t at most 31 so the
+                // product always fits in 16 bits.
+                __m128i light_lo = _mm_add_epi16(from, _mm_srai_epi16(_mm_mullo_epi16(delta, t_lo), 5));
+                __m128i light_hi = _mm_add_epi16(from, _mm_srai_epi16(_mm_mullo_epi16(delta, t_hi), 5));
+
+                __m128i* pixels = (__m128i*)(row + x);
+                _mm_storeu_si128(
+                    pixels,
+                    MultiplyLight4(_mm_loadu_si128(pixels), _mm_add_epi16(light_lo, one), _mm_add_epi16(light_hi, one))
+                );
+
+                t_lo = _mm_add_epi16(t_lo, four);
+                t_hi = _mm_add_epi16(t_hi, four);
+            }
+
+            for (; x < span_end; x += 1) {
+                i32 t = x + pass->camera_x - half_tile - tile_x * TILE_SIZE_PIXELS;
+                row[x] = MultiplyLight(row[x], LerpLight(light_a, light_b, t));
+            }
+        }
+    }
+}
+
+// The light at a single point on the screen, worked out the same way as the
+// passes above, for when there are no pixels to apply it to.
+u32 SampleLight(struct LightingPass* pass, i32 x, i32 y) {
+    i32 world_x = x + pass->camera_x;
+    i32 world_y = y + pass->camera_y;
+
+    u32 result;
+
+    if (pass->per_pixel) {
+        world_x -= TILE_SIZE_PIXELS / 2;
+        world_y -= TILE_SIZE_PIXELS / 2;
+
+        i32 tile_x = FloorDiv(world_x, TILE_SIZE_PIXELS);
+        i32 tile_y = FloorDiv(world_y, TILE_SIZE_PIXELS);
+        i32 t_x    = world_x - tile_x * TILE_SIZE_PIXELS;
+        i32 t_y    = world_y - tile_y * TILE_SIZE_PIXELS;
+
+        u32 top    = LerpLight(LightAt(pass->map, tile_x, tile_y),     LightAt(pass->map, tile_x + 1, tile_y),     t_x);
+        u32 bottom = LerpLight(LightAt(pass->map, tile_x, tile_y + 1), LightAt(pass->map, tile_x + 1, tile_y + 1), t_x);
+
+        result = LerpLight(top, bottom, t_y);
+    } else {
+        result = LightAt(pass->map, FloorDiv(world_x, TILE_SIZE_PIXELS), FloorDiv(world_y, TILE_SIZE_PIXELS));
+    }
+
+    return(result);
+}
+
+void ApplyLighting(struct OffscreenBuffer* buffer, struct Rect clip, struct LightingPass* pass) {
+    if (pass->per_pixel) {
+        ApplyPixelLighting(buffer, clip, pass);
+    } else {
+        ApplyTileLighting(buffer, clip, pass);
+    }
+}
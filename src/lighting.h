@@ -0,0 +1,38 @@
+// ==============================================
+// Lighting
+// ==============================================
+
+struct Light {
+    i32 x;
+    i32 y;
+    i32 radius;
+    u32 colour;
+};
+
+// Light reaching each tile of the map, stored as packed ARGB where 255 means the
+// tile is drawn at full brightness. Alpha is always 255 so the multiply keeps the
+// alpha of whatever it is applied to.
+struct LightMap {
+    u32  width;
+    u32  height;
+    u32* light;
+    u32  ambient;
+
+    // What the map was last built from. It is only rebuilt when one of these changes.
+    bool is_valid;
+    u32  tile_map_version;
+    u32  lights_version;
+};
+
+// Each pass pushes all of its jobs before waiting on any, and the job queue
+// only holds 256 entries.
+#define MAX_LIGHT_JOBS 64
+
+// Handed to the renderer so that each screen tile can light itself once the
+// world layers have been drawn.
+struct LightingPass {
+    struct LightMap* map;
+           i32       camera_x;
+           i32       camera_y;
+           bool      per_pixel;
+};
@@ -18,6 +18,7 @@
 
 #include <stdbool.h>
 #include <string.h>
+#include <emmintrin.h>
 #include <SDL.h>
 
 typedef unsigned long long u64;
@@ -175,6 +176,19 @@ void CompleteRemainingWork(struct JobQueue* queue) {
     queue->completion_goal = 0;
 }
 
+// The acquire and release pair the game uses to hand data between threads.
+u32 AtomicLoad(volatile u32* value) {
+    u32 result = *value;
+    SDL_MemoryBarrierAcquire();
+
+    return(result);
+}
+
+void AtomicStore(volatile u32* value, u32 new_value) {
+    SDL_MemoryBarrierRelease();
+    *value = new_value;
+}
+
 static volatile bool threads_should_run;
 
 struct ThreadInfo {
@@ -200,16 +214,200 @@ i32 ThreadMain(void* user_data) {
 // Offscreen Buffer
 // ==============================================
 
-void InitOffscreenBuffer(
-    struct SDL_Window* window,
-    struct SDL_Renderer* renderer,
-    struct SDL_Texture** texture,
-    struct OffscreenBuffer* offscreen_buffer
+// The game renders into plain CPU memory and each finished frame is copied into
+// its own texture. Cycling through a few textures means we never write to one
+// the driver might still be reading from for an earlier frame, and the game
+// never has to read back out of locked texture memory, which can be uncached.
+// The upload is finished before the next frame is rendered, so one CPU buffer
+// is all that is needed.
+#define OFFSCREEN_BUFFER_COUNT 3
+#define UPLOAD_TIMING_FRAMES   600
+
+// Smaller than this and there is nothing left of the view worth drawing.
+#define MIN_WINDOW_WIDTH  320
+#define MIN_WINDOW_HEIGHT 180
+
+// Resizes that need new buffers wait until the window has stopped changing size
+// for this long, until then the last frame size is stretched to fit.
+#define RESIZE_SETTLE_SECONDS 0.25f
+
+struct OffscreenBufferRing {
+    struct OffscreenBuffer buffer;
+    struct SDL_Texture*    textures[OFFSCREEN_BUFFER_COUNT];
+           u32             current;
+      enum PixelFormat     format;
+
+    // The buffers and textures are allocated bigger than the window, any size
+    // up to this only changes how much of them is used.
+           i32             capacity_width;
+           i32             capacity_height;
+
+    // The renderer's limit on texture sizes, zero when it has none.
+           i32             max_texture_width;
+           i32             max_texture_height;
+
+           bool            resize_pending;
+           i32             pending_width;
+           i32             pending_height;
+           u64             pending_since;
+};
+
+static u32 sdl_pixel_formats[PixelFormatCount] = {
+    [PixelFormatARGB8888] = SDL_PIXELFORMAT_ARGB8888,
+    [PixelFormatABGR8888] = SDL_PIXELFORMAT_ABGR8888,
+    [PixelFormatRGBA8888] = SDL_PIXELFORMAT_RGBA8888,
+    [PixelFormatBGRA8888] = SDL_PIXELFORMAT_BGRA8888,
+};
+
+// Renderers list their texture formats best first. If we hand them anything
+// else the driver converts every pixel on upload, so we pick the first one the
+// game can render directly. The X formats have the same layout with the alpha
+// ignored, so they work as well. They are named RGB888 and BGR888 here, the
+// XRGB8888 names are only aliases from SDL 2.0.14 on.
+enum PixelFormat ChooseNativeFormat(struct SDL_Renderer* renderer) {
+    SDL_RendererInfo info;
+
+    enum PixelFormat result = PixelFormatARGB8888;
+         bool        found  = false;
+
+    if (SDL_GetRendererInfo(renderer, &info) == 0) {
+        for (u32 i = 0; i < info.num_texture_formats && !found; i += 1) {
+            u32 format = info.texture_formats[i];
+
+            for (u32 j = 0; j < PixelFormatCount && !found; j += 1) {
+                if (format == sdl_pixel_formats[j]) {
+                    result = (enum PixelFormat)j;
+                    found  = true;
+                }
+            }
+
+            if (!found && format == SDL_PIXELFORMAT_RGB888) {
+                result = PixelFormatARGB8888;
+                found  = true;
+            } else if (!found && format == SDL_PIXELFORMAT_BGR888) {
+                result = PixelFormatABGR8888;
+                found  = true;
+            }
+        }
+    }
+
+    return(result);
+}
+
+void FreeOffscreenBuffers(struct OffscreenBufferRing* ring) {
+    for (u32 i = 0; i < OFFSCREEN_BUFFER_COUNT; i += 1) {
+        if (ring->textures[i] != NULL) {
+            SDL_DestroyTexture(ring->textures[i]);
+            ring->textures[i] = NULL;
+        }
+    }
+
+    free(ring->buffer.pixels);
+    ring->buffer.pixels = NULL;
+}
+
+// The pitch stays that of the capacity, so nothing is moved around.
+void SetOffscreenBufferSize(struct OffscreenBufferRing* ring, i32 width, i32 height) {
+    ring->buffer.width  = width;
+    ring->buffer.height = height;
+}
+
+// The old buffers are only let go once all of the new ones are allocated, so
+// running out of memory leaves the ring as it was. Returns whether it was
+// resized.
+bool AllocateOffscreenBuffers(
+    struct SDL_Renderer*        renderer,
+    struct OffscreenBufferRing* ring,
+    i32                         width,
+    i32                         height
+) {
+    // A quarter again, so that dragging the window a little bigger doesn't
+    // need another allocation straight away. The extra is trimmed to what the
+    // renderer can make, the window's own size is always asked for.
+    i32 capacity_width  = (width  + width  / 4 + 63) & ~63;
+    i32 capacity_height = (height + height / 4 + 63) & ~63;
+
+    if (ring->max_texture_width > 0) {
+        capacity_width = Max(width, Min(capacity_width, ring->max_texture_width));
+    }
+
+    if (ring->max_texture_height > 0) {
+        capacity_height = Max(height, Min(capacity_height, ring->max_texture_height));
+    }
+
+    i32   pitch  = capacity_width * 4;
+    void* pixels = malloc((u64)pitch * capacity_height);
+
+    struct SDL_Texture* textures[OFFSCREEN_BUFFER_COUNT] = {};
+           bool         has_textures                     = true;
+
+    for (u32 i = 0; i < OFFSCREEN_BUFFER_COUNT && pixels && has_textures; i += 1) {
+        textures[i] = SDL_CreateTexture(
+            renderer,
+            sdl_pixel_formats[ring->format],
+            SDL_TEXTUREACCESS_STREAMING,
+            capacity_width,
+            capacity_height
+        );
+
+        has_textures = textures[i] != NULL;
+    }
+
+    bool resized = pixels && has_textures;
+
+    if (resized) {
+        FreeOffscreenBuffers(ring);
+
+        ring->capacity_width  = capacity_width;
+        ring->capacity_height = capacity_height;
+
+        for (u32 i = 0; i < OFFSCREEN_BUFFER_COUNT; i += 1) {
+            ring->textures[i] = textures[i];
+        }
+
+        ring->buffer.bytes_per_pixel = 4;
+        ring->buffer.format          = ring->format;
+        ring->buffer.pitch           = pitch;
+        ring->buffer.pixels          = pixels;
+
+        SetOffscreenBufferSize(ring, width, height);
+
+        ring->current = 0;
+    } else {
+        if (!pixels) {
+            SDL_Log("Unable to allocate a %dx%d offscreen buffer.\n", capacity_width, capacity_height);
+        } else {
+            SDL_Log("Unable to create a %dx%d offscreen texture. %s\n", capacity_width, capacity_height, SDL_GetError());
+        }
+
+        for (u32 i = 0; i < OFFSCREEN_BUFFER_COUNT; i += 1) {
+            if (textures[i] != NULL) {
+                SDL_DestroyTexture(textures[i]);
+            }
+        }
+
+        free(pixels);
+    }
+
+    return(resized);
+}
+
+bool InitOffscreenBuffers(
+    struct SDL_Window*          window,
+    struct SDL_Renderer*        renderer,
+    struct OffscreenBufferRing* ring
 ) {
     i32 window_width;
     i32 window_height;
     SDL_GetWindowSize(window, &window_width, &window_height);
 
+    struct SDL_RendererInfo info;
+
+    if (SDL_GetRendererInfo(renderer, &info) == 0) {
+        ring->max_texture_width  = info.max_texture_width;
+        ring->max_texture_height = info.max_texture_height;
+    }
+
     // Not sure if I need to care about this stuff.
     // u32 window_id = SDL_GetWindowID(window);
     // f32 diagonal_dpi;
@@ -217,19 +415,173 @@ void InitOffscreenBuffer(
     // f32 vertical_dpi;
     // SDL_GetDisplayDPI(window_id, &diagonal_dpi, &horizontal_dpi, &vertical_dpi);
 
-    *texture = SDL_CreateTexture(
-        renderer,
-        SDL_PIXELFORMAT_ARGB8888,
-        SDL_TEXTUREACCESS_STREAMING,
-        window_width,
-        window_height
-    );
+    return(AllocateOffscreenBuffers(renderer, ring, window_width, window_height));
+}
+
+// Dragging the edge of a window sends a resize for nearly every frame, so they
+// are only recorded here and dealt with once per frame.
+void RequestResize(struct OffscreenBufferRing* ring, i32 width, i32 height) {
+    ring->resize_pending = true;
+    ring->pending_width  = width;
+    ring->pending_height = height;
+    ring->pending_since  = SDL_GetPerformanceCounter();
+}
+
+// Sizes that fit in the buffers we already have are used straight away, bigger
+// ones wait for the window to settle so we only reallocate once.
+void ApplyPendingResize(struct SDL_Renderer* renderer, struct OffscreenBufferRing* ring) {
+    if (ring->resize_pending) {
+        i32 width  = ring->pending_width;
+        i32 height = ring->pending_height;
+
+        f32 seconds_pending = (f32)(SDL_GetPerformanceCounter() - ring->pending_since)
+                            / (f32)SDL_GetPerformanceFrequency();
+
+        if (width <= ring->capacity_width && height <= ring->capacity_height) {
+            SetOffscreenBufferSize(ring, width, height);
+            ring->resize_pending = false;
+        } else if (seconds_pending >= RESIZE_SETTLE_SECONDS) {
+            // Without room for the new size the old buffers are kept and the
+            // frame is stretched to fit, like while the window settles.
+            if (!AllocateOffscreenBuffers(renderer, ring, width, height)) {
+                SetOffscreenBufferSize(ring, Min(width, ring->capacity_width), Min(height, ring->capacity_height));
+            }
+
+            ring->resize_pending = false;
+        }
+    }
+}
+
+// ==============================================
+// Geometry
+// ==============================================
+
+// SDL_RenderGeometry only exists from 2.0.18, before that every frame goes
+// through the offscreen buffers.
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+    #define HAS_GEOMETRY_BACKEND 1
+#else
+    #define HAS_GEOMETRY_BACKEND 0
+#endif
+
+#if HAS_GEOMETRY_BACKEND
+
+// The game's vertices are handed to SDL as they are.
+typedef char GeometryVertexMatchesSdl[sizeof(struct GeometryVertex) == sizeof(SDL_Vertex) ? 1 : -1];
 
-    offscreen_buffer->bytes_per_pixel = 4;
-    offscreen_buffer->width           = window_width;
-    offscreen_buffer->height          = window_height;
+#define GEOMETRY_TEXTURE_COUNT 8
+
+// The textures made for the game's images, each is uploaded again whenever the
+// game bumps its version.
+struct GeometryTextures {
+    struct GeometryTexture* images  [GEOMETRY_TEXTURE_COUNT];
+    struct SDL_Texture*     textures[GEOMETRY_TEXTURE_COUNT];
+           u32              versions[GEOMETRY_TEXTURE_COUNT];
+};
+
+// Returns NULL if the cache is full or the texture can't be made, the frame
+// can't be drawn right without it.
+struct SDL_Texture* GetGeometryTexture(
+    struct SDL_Renderer*     renderer,
+    struct GeometryTextures* cache,
+    struct GeometryTexture*  image
+) {
+    u32 slot = 0;
+
+    while (slot < GEOMETRY_TEXTURE_COUNT && cache->images[slot] != image && cache->images[slot] != NULL) {
+        slot += 1;
+    }
+
+    struct SDL_Texture* texture = NULL;
+
+    if (slot == GEOMETRY_TEXTURE_COUNT) {
+        SDL_Log("More than %d geometry textures.\n", GEOMETRY_TEXTURE_COUNT);
+    } else if (cache->images[slot] == NULL) {
+        // Packed ABGR is RGBA byte order, the same as the vertex colours.
+        texture = SDL_CreateTexture(
+            renderer,
+            SDL_PIXELFORMAT_ABGR8888,
+            SDL_TEXTUREACCESS_STATIC,
+            image->width,
+            image->height
+        );
+
+        if (texture != NULL) {
+            SDL_SetTextureScaleMode(texture, SDL_ScaleModeNearest);
+
+            cache->images  [slot] = image;
+            cache->textures[slot] = texture;
+            cache->versions[slot] = image->version - 1;
+        } else {
+            SDL_Log("Unable to create a %dx%d geometry texture. %s\n", image->width, image->height, SDL_GetError());
+        }
+    } else {
+        texture = cache->textures[slot];
+    }
+
+    if (texture != NULL && cache->versions[slot] != image->version) {
+        SDL_UpdateTexture(texture, NULL, image->pixels, image->width * sizeof(u32));
+        cache->versions[slot] = image->version;
+    }
+
+    return(texture);
+}
+
+void FreeGeometryTextures(struct GeometryTextures* cache) {
+    for (u32 i = 0; i < GEOMETRY_TEXTURE_COUNT; i += 1) {
+        if (cache->textures[i] != NULL) {
+            SDL_DestroyTexture(cache->textures[i]);
+        }
+
+        cache->images  [i] = NULL;
+        cache->textures[i] = NULL;
+    }
 }
 
+// One SDL_RenderGeometry call per batch. Returns false if a batch's texture
+// couldn't be had or the renderer turned a batch down, in which case the frame
+// is incomplete.
+bool DrawGeometry(struct SDL_Renderer* renderer, struct GeometryTextures* cache, struct GeometryBuffer* geometry) {
+    u32 clear = geometry->clear_colour;
+
+    SDL_SetRenderDrawColor(renderer, (clear >> 16) & 0xFF, (clear >> 8) & 0xFF, clear & 0xFF, 0xFF);
+    SDL_RenderClear(renderer);
+
+    bool is_drawn = true;
+
+    for (u32 i = 0; i < geometry->batch_count && is_drawn; i += 1) {
+        struct GeometryBatch* batch   = &geometry->batches[i];
+        struct SDL_Texture*   texture = NULL;
+
+        SDL_BlendMode blend = (batch->blend == GeometryBlendAdd) ? SDL_BLENDMODE_ADD : SDL_BLENDMODE_BLEND;
+
+        // Flat triangles use the draw blend mode, textured ones their texture's.
+        if (batch->texture) {
+            texture  = GetGeometryTexture(renderer, cache, batch->texture);
+            is_drawn = texture != NULL;
+
+            if (is_drawn) {
+                SDL_SetTextureBlendMode(texture, blend);
+            }
+        } else {
+            SDL_SetRenderDrawBlendMode(renderer, blend);
+        }
+
+        is_drawn = is_drawn && SDL_RenderGeometry(
+            renderer,
+            texture,
+            (SDL_Vertex*)geometry->vertices,
+            geometry->vertex_count,
+            geometry->indices + batch->first_index,
+            batch->index_count
+        ) == 0;
+    }
+
+    return(is_drawn);
+}
+
+#endif
+
 // ==============================================
 // Game Memory
 // ==============================================
@@ -264,19 +616,42 @@ void FreeMemory(struct Memory memory) {
     free(memory.permanent);
 }
 
+// ==============================================
+// Timing
+// ==============================================
+
+u64 GetWallClock(void) {
+    return(SDL_GetPerformanceCounter());
+}
+
+f32 GetSecondsElapsed(u64 begin, u64 end) {
+    return((f32)(end - begin) / (f32)SDL_GetPerformanceFrequency());
+}
+
 // ==============================================
 // File IO
 // ==============================================
 
 struct DebugFile DebugOpenFile(char* filename) {
     struct DebugFile  file = {};
-    struct SDL_RWops* io   = SDL_RWFromFile(filename, "r");
+    struct SDL_RWops* io   = SDL_RWFromFile(filename, "rb");
 
     if (io) {
-        u64 size = SDL_RWsize(io);
-        file.data = malloc(size);
+        i64 size = SDL_RWsize(io);
+
+        if (size > 0) {
+            file.data = malloc(size);
+
+            // A short read is treated like a missing file, callers only ever
+            // need to check the size.
+            if (file.data && SDL_RWread(io, file.data, size, 1) == 1) {
+                file.size = size;
+            } else {
+                free(file.data);
+                file.data = NULL;
+            }
+        }
 
-        SDL_RWread(io, file.data, size, 1);
         SDL_RWclose(io);
     }
 
@@ -287,6 +662,41 @@ void DebugCloseFile(struct DebugFile file) {
     free(file.data);
 }
 
+struct DebugStream DebugOpenStream(char* filename) {
+    struct DebugStream stream = {};
+    struct SDL_RWops*  io     = SDL_RWFromFile(filename, "rb");
+
+    if (io) {
+        i64 size = SDL_RWsize(io);
+
+        if (size > 0) {
+            stream.size   = size;
+            stream.handle = io;
+        } else {
+            SDL_RWclose(io);
+        }
+    }
+
+    return(stream);
+}
+
+// Returns how many bytes were read, which is short at the end of the file.
+u64 DebugReadStream(struct DebugStream stream, u64 offset, void* buffer, u64 size) {
+    u64 read = 0;
+
+    if (stream.handle && SDL_RWseek((struct SDL_RWops*)stream.handle, offset, RW_SEEK_SET) == (i64)offset) {
+        read = SDL_RWread((struct SDL_RWops*)stream.handle, buffer, 1, size);
+    }
+
+    return(read);
+}
+
+void DebugCloseStream(struct DebugStream stream) {
+    if (stream.handle) {
+        SDL_RWclose((struct SDL_RWops*)stream.handle);
+    }
+}
+
 // ==============================================
 // Timing Info
 // ==============================================
@@ -321,37 +731,336 @@ struct TimingInfo GetTimingInfo(struct SDL_Window* window) {
 // Audio
 // ==============================================
 
-void OpenAudio(SDL_AudioDeviceID* device, struct AudioBuffer* buffer) {
-    // TODO(Hector):
-    // Work out how big these buffers actually need to be.
+// Frames SDL asks for in each callback. The play cursor can only be tracked to
+// within one of these, and every one adds to the latency, so it is kept small.
+#define AUDIO_DEVICE_FRAMES 256
+
+// About a third of a second at 48 kHz, far more than is ever written ahead.
+#define AUDIO_RING_FRAMES 16384
+
+// Used when --audio-latency-ms isn't given.
+#define AUDIO_DEFAULT_LATENCY_MS 20
+
+// How much of the jitter margin is kept from one frame to the next. At 60 Hz a
+// single slow frame stops counting after a few seconds.
+#define AUDIO_JITTER_DECAY 0.99f
+
+// Frames between logging the measured latency.
+#define AUDIO_TIMING_FRAMES 600
+
+// Filled by the game on the main thread and drained by SDL's audio callback on
+// its own thread. Each side only moves its own cursor, so there are no locks.
+// The cursors count bytes and are only wrapped when indexing.
+//
+// The allocation is twice the ring's size, so the game can always mix into one
+// run of memory. Whatever goes past the end is copied back to the start before
+// it is published.
+struct AudioRing {
+             u8*          data;
+             u32          size; // A power of two.
+             u32          bytes_per_sample;
+             SDL_atomic_t read;
+             SDL_atomic_t write;
+             SDL_atomic_t underruns;
+
+    // When the callback last ran, so the play cursor can be moved along
+    // between callbacks.
+    volatile u64          callback_time;
+};
+
+// Decides how much the game writes each frame. The aim is to keep the write
+// cursor the target latency ahead of what is actually playing, plus a margin
+// for however late frames have been arriving lately.
+struct AudioScheduler {
+    u32 bytes_per_second;
+    u32 device_bytes;
+    f32 target_latency_seconds;
+    f32 jitter_seconds;
+    u32 underruns_reported;
+
+    // Averaged over a number of frames and logged.
+    u64 latency_total;
+    u32 latency_count;
+};
+
+// Runs on SDL's audio thread.
+void FillAudioDevice(void* user_data, u8* stream, i32 length) {
+    struct AudioRing* ring = (struct AudioRing*)user_data;
+
+    u32 read   = SDL_AtomicGet(&ring->read);
+    u32 write  = SDL_AtomicGet(&ring->write);
+    u32 count  = Min(write - read, (u32)length);
+    u32 offset = read & (ring->size - 1);
+    u32 first  = Min(count, ring->size - offset);
+
+    memcpy(stream,         ring->data + offset, first);
+    memcpy(stream + first, ring->data,          count - first);
+
+    // Running dry plays silence, not whatever the device had last. It only
+    // counts as an underrun once the game has started writing.
+    memset(stream + count, 0, length - count);
+
+    if (count < (u32)length && write != 0) {
+        SDL_AtomicIncRef(&ring->underruns);
+    }
+
+    ring->callback_time = SDL_GetPerformanceCounter();
+
+    SDL_CompilerBarrier();
+    SDL_AtomicSet(&ring->read, read + count);
+}
+
+void InitAudioScheduler(struct AudioScheduler* scheduler, struct AudioBuffer* buffer, u32 latency_ms) {
+    *scheduler = (struct AudioScheduler){
+        .bytes_per_second       = buffer->samples_per_second * buffer->bytes_per_sample,
+        .device_bytes           = AUDIO_DEVICE_FRAMES * buffer->bytes_per_sample,
+        .target_latency_seconds = (f32)latency_ms / 1000.0f,
+    };
+}
+
+// Where the speakers have got to, in ring bytes. Each callback hands over a
+// device buffer that then plays out over the buffer's length, so the cursor
+// is moved along from the start of the last one by the time since.
+u32 EstimatePlayCursor(struct AudioRing* ring, struct AudioScheduler* scheduler) {
+    u64 callback_time = ring->callback_time;
+    u32 read          = SDL_AtomicGet(&ring->read);
+    f32 seconds       = GetSecondsElapsed(callback_time, SDL_GetPerformanceCounter());
+    u32 played        = (u32)Min(seconds * (f32)scheduler->bytes_per_second, (f32)scheduler->device_bytes);
+
+    played -= played % ring->bytes_per_sample;
+
+    return(read - scheduler->device_bytes + played);
+}
+
+// How far ahead of the play cursor to write this frame. Whatever is written has
+// to last until the next frame's write, while the device holds on to the
+// buffer it is playing and the callback takes the next one whole. So it is
+// never less than a frame and two device buffers, and the worst lateness seen
+// recently goes on top.
+u32 AudioWriteAhead(struct AudioScheduler* scheduler, struct AudioRing* ring, f32 seconds_per_frame, f32 seconds_elapsed) {
+    f32 lateness = seconds_elapsed - seconds_per_frame;
+    scheduler->jitter_seconds = Max(scheduler->jitter_seconds * AUDIO_JITTER_DECAY, lateness);
+
+    // Underruns mean the margin was too small however it was worked out, so
+    // it grows by a device buffer each time.
+    u32 underruns = SDL_AtomicGet(&ring->underruns);
+
+    if (underruns != scheduler->underruns_reported) {
+        SDL_Log("Audio underrun, %u so far.\n", underruns);
+
+        scheduler->underruns_reported = underruns;
+        scheduler->jitter_seconds    += (f32)scheduler->device_bytes / (f32)scheduler->bytes_per_second;
+    }
+
+    f32 minimum = seconds_per_frame + 2.0f * (f32)scheduler->device_bytes / (f32)scheduler->bytes_per_second;
+    f32 seconds = Max(scheduler->target_latency_seconds, minimum) + scheduler->jitter_seconds;
+
+    return((u32)(seconds * (f32)scheduler->bytes_per_second));
+}
+
+// Points the audio buffer straight into the ring, sized to bring the write
+// cursor back up to `target_bytes` ahead of the play cursor.
+void BeginAudioWrite(struct AudioRing* ring, struct AudioBuffer* buffer, u32 play_cursor, u32 target_bytes) {
+    u32 read   = SDL_AtomicGet(&ring->read);
+    u32 write  = SDL_AtomicGet(&ring->write);
+    u32 ahead  = write - play_cursor;
+    u32 bytes  = (target_bytes > ahead) ? target_bytes - ahead : 0;
+
+    bytes  = Min(bytes, ring->size - (write - read));
+    bytes -= bytes % ring->bytes_per_sample;
+
+    buffer->samples      = (u16*)(ring->data + (write & (ring->size - 1)));
+    buffer->samples_size = bytes;
+}
+
+void EndAudioWrite(struct AudioRing* ring, struct AudioBuffer* buffer) {
+    u32 write  = SDL_AtomicGet(&ring->write);
+    u32 offset = write & (ring->size - 1);
+    u32 end    = offset + buffer->samples_size;
+
+    if (end > ring->size) {
+        memcpy(ring->data, ring->data + ring->size, end - ring->size);
+    }
+
+    SDL_CompilerBarrier();
+    SDL_AtomicSet(&ring->write, write + buffer->samples_size);
+}
+
+void OpenAudio(SDL_AudioDeviceID* device, struct AudioRing* ring, struct AudioBuffer* buffer) {
     i32 audio_frequency  = 48000;
     i32 channel_count    = 2;
     i32 bytes_per_sample = sizeof(i16) * channel_count;
-    // i32 buffer_size      = audio_frequency * bytes_per_sample;
-    // i32 buffer_size      = 1024;
+
+    ring->size             = AUDIO_RING_FRAMES * bytes_per_sample;
+    ring->bytes_per_sample = bytes_per_sample;
+    ring->data             = calloc(ring->size * 2, 1);
+
+    SDL_AtomicSet(&ring->read,      0);
+    SDL_AtomicSet(&ring->write,     0);
+    SDL_AtomicSet(&ring->underruns, 0);
+    ring->callback_time = 0;
 
     SDL_AudioSpec audio_spec = {};
     audio_spec.freq     = audio_frequency;
     audio_spec.format   = AUDIO_S16LSB;
     audio_spec.channels = channel_count;
-    audio_spec.samples  = audio_frequency * sizeof(u16);
+    audio_spec.samples  = AUDIO_DEVICE_FRAMES;
+    audio_spec.callback = &FillAudioDevice;
+    audio_spec.userdata = ring;
 
     char*          device_name     = NULL;
     bool           is_capture      = false;
     SDL_AudioSpec* desired         = NULL;
     i32            allowed_changes = 0;
 
-    *device = SDL_OpenAudioDevice(device_name, is_capture, &audio_spec, desired, allowed_changes);
+    *device = ring->data ? SDL_OpenAudioDevice(device_name, is_capture, &audio_spec, desired, allowed_changes) : 0;
 
-    // buffer->samples            = malloc(buffer_size);
-    // buffer->samples_size       = buffer_size;
+    buffer->samples            = NULL;
+    buffer->samples_size       = 0;
     buffer->samples_per_second = audio_spec.freq;
     buffer->bytes_per_sample   = bytes_per_sample;
+
+    // The callback plays silence until the game has written something.
+    if (*device != 0) {
+        SDL_PauseAudioDevice(*device, 0);
+    }
+}
+
+void CloseAudio(SDL_AudioDeviceID device, struct AudioRing* ring) {
+    if (device != 0) {
+        SDL_CloseAudioDevice(device);
+    }
+
+    free(ring->data);
+}
+
+// ==============================================
+// Offline Audio
+// ==============================================
+
+// The rate the device is asked for, so recordings match what plays.
+#define OFFLINE_SAMPLES_PER_SECOND 48000
+#define OFFLINE_MAX_SECONDS        3600
+
+#define WAV_HEADER_SIZE 44
+
+void PutU16(u8* data, u32 value) {
+    data[0] = (u8)(value >> 0);
+    data[1] = (u8)(value >> 8);
 }
 
-void CloseAudio(struct AudioBuffer buffer) {
-    // free(buffer.samples);
-    SDL_CloseAudio();
+void PutU32(u8* data, u32 value) {
+    PutU16(data + 0, value & 0xFFFF);
+    PutU16(data + 2, value >> 16);
+}
+
+// Fills in the header of a 16 bit stereo WAV file.
+void PutWavHeader(u8* header, u32 data_size, u32 samples_per_second) {
+    memcpy(header +  0, "RIFF", 4);
+    PutU32(header +  4, 36 + data_size);
+    memcpy(header +  8, "WAVEfmt ", 8);
+    PutU32(header + 16, 16);
+    PutU16(header + 20, 1);
+    PutU16(header + 22, 2);
+    PutU32(header + 24, samples_per_second);
+    PutU32(header + 28, samples_per_second * 4);
+    PutU16(header + 32, 4);
+    PutU16(header + 34, 16);
+    memcpy(header + 36, "data", 4);
+    PutU32(header + 40, data_size);
+}
+
+// Goldens are files this wrote before, so a match is the whole file matching
+// byte for byte. When it doesn't, how far apart the samples are tells a
+// rounding change from a broken mixer.
+bool MatchesGolden(char* filename, u8* file, u64 file_size) {
+    struct DebugFile golden = DebugOpenFile(filename);
+
+    bool matches = golden.size == file_size && memcmp(golden.data, file, file_size) == 0;
+
+    if (golden.size == 0) {
+        SDL_Log("Unable to read golden %s.\n", filename);
+    } else if (golden.size != file_size) {
+        SDL_Log("Golden %s is %llu bytes, the render is %llu.\n", filename, golden.size, file_size);
+    } else if (!matches) {
+        i16* expected      = (i16*)((u8*)golden.data + WAV_HEADER_SIZE);
+        i16* actual        = (i16*)(file + WAV_HEADER_SIZE);
+        u64  sample_count  = (file_size - WAV_HEADER_SIZE) / sizeof(i16);
+        u64  first         = sample_count;
+        u64  differences   = 0;
+        i32  max_error     = 0;
+
+        for (u64 i = 0; i < sample_count; i += 1) {
+            i32 error = Abs((i32)actual[i] - (i32)expected[i]);
+
+            first        = (error != 0 && first == sample_count) ? i : first;
+            differences += (error != 0);
+            max_error    = Max(max_error, error);
+        }
+
+        SDL_Log(
+            "Render differs from golden %s: %llu samples, up to %d apart, first at %.3f s.\n",
+            filename, differences, max_error, (f64)(first / 2) / (f64)OFFLINE_SAMPLES_PER_SECOND
+        );
+    }
+
+    DebugCloseFile(golden);
+
+    return(matches);
+}
+
+// Runs the audio script for `seconds` with no window or device, writes it to
+// `filename` as a WAV file and, given a golden, checks it is unchanged. The
+// mixer's throughput is logged, so optimisations can be measured on the same
+// run that shows they didn't change the output.
+i32 RenderAudioOffline(f32 seconds, char* filename, char* golden) {
+    i32 result = EXIT_FAILURE;
+
+    u32    frame_count = (u32)(Clamp(seconds, 0.0f, (f32)OFFLINE_MAX_SECONDS) * OFFLINE_SAMPLES_PER_SECOND);
+    u64    data_size   = (u64)frame_count * 4;
+    u64    file_size   = WAV_HEADER_SIZE + data_size;
+    u8*    file        = (u8*)calloc(1, file_size);
+    struct Memory memory = InitMemory(Megabytes(64), Megabytes(64));
+
+    if (file && memory.permanent) {
+        struct AudioBuffer audio_buffer = {
+            .samples            = (u16*)(file + WAV_HEADER_SIZE),
+            .samples_size       = (i32)data_size,
+            .samples_per_second = OFFLINE_SAMPLES_PER_SECOND,
+            .bytes_per_sample   = 4,
+        };
+
+        PutWavHeader(file, (u32)data_size, OFFLINE_SAMPLES_PER_SECOND);
+
+        f32 mixing_seconds = RenderAudioScript(&memory, &audio_buffer);
+
+        SDL_Log(
+            "Mixed %.1f s of audio in %.3f s, %.0f frames a second, %.0f times real time.\n",
+            (f64)frame_count / OFFLINE_SAMPLES_PER_SECOND,
+            (f64)mixing_seconds,
+            (f64)frame_count / Max((f64)mixing_seconds, 1e-9),
+            (f64)frame_count / OFFLINE_SAMPLES_PER_SECOND / Max((f64)mixing_seconds, 1e-9)
+        );
+
+        struct SDL_RWops* io = SDL_RWFromFile(filename, "wb");
+
+        if (io && SDL_RWwrite(io, file, file_size, 1) == 1) {
+            result = (golden == NULL || MatchesGolden(golden, file, file_size)) ? EXIT_SUCCESS : EXIT_FAILURE;
+        } else {
+            SDL_Log("Unable to write %s. %s\n", filename, SDL_GetError());
+        }
+
+        if (io) {
+            SDL_RWclose(io);
+        }
+    } else {
+        SDL_Log("Unable to allocate memory.");
+    }
+
+    FreeMemory(memory);
+    free(file);
+
+    return(result);
 }
 
 // ==============================================
@@ -359,7 +1068,28 @@ void CloseAudio(struct AudioBuffer buffer) {
 // ==============================================
 
 i32 main(i32 argc, char** argv) {
-    if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_GAMECONTROLLER | SDL_INIT_HAPTIC | SDL_INIT_AUDIO) == 0) {
+    // --render-audio <seconds> <file> mixes the audio script into a WAV file
+    // instead of running the game, needing neither a window nor sound, and
+    // --golden <file> fails the run if it differs from an earlier one.
+    f32   render_seconds = 0.0f;
+    char* render_file    = NULL;
+    char* golden_file    = NULL;
+    i32   exit_code      = EXIT_SUCCESS;
+
+    for (i32 i = 1; i < argc; i += 1) {
+        if (strcmp(argv[i], "--render-audio") == 0 && i + 2 < argc) {
+            render_seconds = (f32)SDL_atof(argv[i + 1]);
+            render_file    = argv[i + 2];
+            i += 2;
+        } else if (strcmp(argv[i], "--golden") == 0 && i + 1 < argc) {
+            i += 1;
+            golden_file = argv[i];
+        }
+    }
+
+    if (render_file) {
+        exit_code = RenderAudioOffline(render_seconds, render_file, golden_file);
+    } else if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_GAMECONTROLLER | SDL_INIT_HAPTIC | SDL_INIT_AUDIO) == 0) {
         // Create tracking variables for multi-threading.
         u32 num_cpus = NumCpus() - 1;
 
@@ -371,6 +1101,13 @@ i32 main(i32 argc, char** argv) {
         job_queue.semaphore = SDL_CreateSemaphore(0);
         job_queue.pool_size = num_cpus;
 
+        // Work that runs across frames, like reading from disk, gets a queue
+        // and a thread of its own, so it never holds up the frame's jobs.
+        struct JobQueue background_queue = {};
+
+        background_queue.semaphore = SDL_CreateSemaphore(0);
+        background_queue.pool_size = 1;
+
         // Spin up the threads.
         threads_should_run = true;
 
@@ -382,32 +1119,97 @@ i32 main(i32 argc, char** argv) {
             threads[i]  = SDL_CreateThread(&ThreadMain, NULL, info);
         }
 
+        struct ThreadInfo   background_info   = { .index = num_cpus, .queue = &background_queue };
+        struct SDL_Thread*  background_thread = SDL_CreateThread(&ThreadMain, NULL, &background_info);
+
+        // Passing --argb keeps the old format, to compare upload times against.
+        // --geometry has the renderer draw the frame from triangles instead of
+        // copying in the offscreen buffer, and --software-renderer asks SDL for
+        // its CPU renderer, so that path can be tried without a GPU.
+        // --audio-latency-ms sets how far ahead of playback sound is written.
+        bool force_argb       = false;
+        bool use_geometry     = false;
+        u32  renderer_flags   = SDL_RENDERER_PRESENTVSYNC;
+        u32  audio_latency_ms = AUDIO_DEFAULT_LATENCY_MS;
+
+        for (i32 i = 1; i < argc; i += 1) {
+            if (strcmp(argv[i], "--argb") == 0) {
+                force_argb = true;
+            } else if (strcmp(argv[i], "--geometry") == 0) {
+                use_geometry = true;
+            } else if (strcmp(argv[i], "--software-renderer") == 0) {
+                renderer_flags |= SDL_RENDERER_SOFTWARE;
+            } else if (strcmp(argv[i], "--audio-latency-ms") == 0 && i + 1 < argc) {
+                i += 1;
+                audio_latency_ms = (u32)Max(SDL_atoi(argv[i]), 0);
+            }
+        }
+
+#if HAS_GEOMETRY_BACKEND
+        // Built against a new enough SDL doesn't mean running with one.
+        SDL_version linked_version;
+        SDL_GetVersion(&linked_version);
+
+        if (use_geometry && SDL_VERSIONNUM(linked_version.major, linked_version.minor, linked_version.patch) < SDL_VERSIONNUM(2, 0, 18)) {
+            SDL_Log("SDL %d.%d.%d has no SDL_RenderGeometry, drawing in software.\n", linked_version.major, linked_version.minor, linked_version.patch);
+            use_geometry = false;
+        }
+#else
+        if (use_geometry) {
+            SDL_Log("Built without SDL_RenderGeometry, drawing in software.\n");
+            use_geometry = false;
+        }
+#endif
+
         struct SDL_Window* window = SDL_CreateWindow(
             "Demon Teacher",
             SDL_WINDOWPOS_CENTERED,
             SDL_WINDOWPOS_CENTERED,
             1280, 720,
-            SDL_WINDOW_SHOWN
+            SDL_WINDOW_SHOWN | SDL_WINDOW_RESIZABLE
         );
 
-        struct SDL_Renderer* renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_PRESENTVSYNC);
+        struct SDL_Renderer* renderer = SDL_CreateRenderer(window, -1, renderer_flags);
 
         SDL_ShowCursor(SDL_DISABLE);
 
         if (window != NULL && renderer != NULL) {
+            SDL_SetWindowMinimumSize(window, MIN_WINDOW_WIDTH, MIN_WINDOW_HEIGHT);
+
             bool   is_close_requested = false;
             struct Memory memory      = InitMemory(Megabytes(64), Gigabytes(4));
 
-            struct OffscreenBuffer offscreen_buffer = {};
-            struct SDL_Texture*    texture;
-            InitOffscreenBuffer(window, renderer, &texture, &offscreen_buffer);
+            struct OffscreenBufferRing offscreen_buffers = {
+                .format = force_argb ? PixelFormatARGB8888 : ChooseNativeFormat(renderer),
+            };
+
+            // Even when drawing with geometry the offscreen buffers are kept, the
+            // game takes the frame size from them and they are there to fall
+            // back on.
+            struct GeometryBuffer geometry_buffer = {};
+
+#if HAS_GEOMETRY_BACKEND
+            struct GeometryTextures geometry_textures = {};
+#endif
+
+            if (use_geometry) {
+                SDL_Log("Rendering with SDL_RenderGeometry\n");
+            } else {
+                SDL_Log("Rendering in %s\n", SDL_GetPixelFormatName(sdl_pixel_formats[offscreen_buffers.format]));
+            }
+
+            bool has_offscreen_buffers = InitOffscreenBuffers(window, renderer, &offscreen_buffers);
 
-            if (memory.permanent) {
+            if (memory.permanent && has_offscreen_buffers) {
                 struct TimingInfo timing_info = GetTimingInfo(window);
 
-                SDL_AudioDeviceID audio_device;
+                SDL_AudioDeviceID  audio_device;
+                struct AudioRing   audio_ring;
                 struct AudioBuffer audio_buffer;
-                OpenAudio(&audio_device, &audio_buffer);
+                OpenAudio(&audio_device, &audio_ring, &audio_buffer);
+
+                struct AudioScheduler audio_scheduler;
+                InitAudioScheduler(&audio_scheduler, &audio_buffer, audio_latency_ms);
 
                 if (audio_device != 0) {
                     u64 frequency    = SDL_GetPerformanceFrequency();
@@ -416,7 +1218,13 @@ i32 main(i32 argc, char** argv) {
                     u64 end_time     = 0;
                     u64 end_cycles   = 0;
 
-                    struct InputState input_state = {};
+                    // Averaged over a number of frames and logged, so the formats can be compared.
+                    u64 upload_time  = 0;
+                    u32 upload_count = 0;
+
+                    struct InputState input_state = {
+                        .seconds_per_frame = timing_info.target_seconds_per_frame,
+                    };
 
                     SDL_Event event;
                     while (!is_close_requested) {
@@ -451,12 +1259,7 @@ i32 main(i32 argc, char** argv) {
 
                                 case SDL_WINDOWEVENT:
                                     if (event.window.event == SDL_WINDOWEVENT_SIZE_CHANGED) {
-                                        if (texture != NULL) {
-                                            SDL_DestroyTexture(texture);
-                                            texture = NULL;
-                                        }
-
-                                        InitOffscreenBuffer(window, renderer, &texture, &offscreen_buffer);
+                                        RequestResize(&offscreen_buffers, event.window.data1, event.window.data2);
                                     }
                                     break;
 
@@ -544,49 +1347,103 @@ i32 main(i32 argc, char** argv) {
                             }
                         }
 
-                        // TODO(Hector):
-                        // Actually work out how many bytes we need to write. Probably need to use seconds_elapsed
-                        // to know how long the last frame took and something something...
-                        u32 one_frames_worth = audio_buffer.samples_per_second
-                                             * audio_buffer.bytes_per_sample
-                                             * timing_info.target_seconds_per_frame;
-
-                        u32 queued_audio_bytes = SDL_GetQueuedAudioSize(audio_device);
-                        u32 bytes_to_write     = one_frames_worth - queued_audio_bytes;
-                        printf("%i %i %i\n", one_frames_worth, queued_audio_bytes, bytes_to_write);
-
-                        audio_buffer.samples      = malloc(bytes_to_write);
-                        audio_buffer.samples_size = bytes_to_write;
-
-                        SDL_LockTexture(texture, NULL, &offscreen_buffer.pixels, &offscreen_buffer.pitch);
-                        UpdateAndRender(&memory, &input_state, &job_queue, &offscreen_buffer, &audio_buffer);
-                        SDL_UnlockTexture(texture);
-
-                        SDL_QueueAudio(audio_device, audio_buffer.samples, bytes_to_write);
-                        free(audio_buffer.samples);
-                        // TODO(Hector):
-                        // Clean this up.
-                        static bool audio_is_paused = true;
-                        if (audio_is_paused) {
-                            audio_is_paused = false;
-                            SDL_PauseAudioDevice(audio_device, audio_is_paused);
+                        u32 write_ahead_bytes = AudioWriteAhead(
+                            &audio_scheduler,
+                            &audio_ring,
+                            timing_info.target_seconds_per_frame,
+                            seconds_elapsed
+                        );
+                        u32 play_cursor = EstimatePlayCursor(&audio_ring, &audio_scheduler);
+
+                        BeginAudioWrite(&audio_ring, &audio_buffer, play_cursor, write_ahead_bytes);
+
+                        ApplyPendingResize(renderer, &offscreen_buffers);
+
+                        u32                     current          = offscreen_buffers.current;
+                        struct OffscreenBuffer* offscreen_buffer = &offscreen_buffers.buffer;
+                        struct SDL_Texture*     texture          =  offscreen_buffers.textures[current];
+
+                        UpdateAndRender(
+                            &memory,
+                            &input_state,
+                            &job_queue,
+                            &background_queue,
+                            offscreen_buffer,
+                            use_geometry ? &geometry_buffer : NULL,
+                            &audio_buffer
+                        );
+
+                        EndAudioWrite(&audio_ring, &audio_buffer);
+
+                        audio_scheduler.latency_total += SDL_AtomicGet(&audio_ring.write) - play_cursor;
+                        audio_scheduler.latency_count += 1;
+
+                        if (audio_scheduler.latency_count == AUDIO_TIMING_FRAMES) {
+                            SDL_Log(
+                                "Audio latency: %.1f ms, jitter margin %.1f ms\n",
+                                (f64)audio_scheduler.latency_total * 1000.0 / (f64)audio_scheduler.bytes_per_second / (f64)audio_scheduler.latency_count,
+                                audio_scheduler.jitter_seconds * 1000.0f
+                            );
+                            audio_scheduler.latency_total = 0;
+                            audio_scheduler.latency_count = 0;
                         }
 
-                        SDL_RenderCopy(renderer, texture, NULL, NULL);
-                        SDL_RenderPresent(renderer);
-                    }
+                        // The frame went to the geometry buffer, so there is nothing in
+                        // the offscreen buffer to show if the geometry can't be drawn.
+                        bool skip_present = false;
+
+#if HAS_GEOMETRY_BACKEND
+                        // If the renderer can't take the triangles after all, the rest of the
+                        // frames are drawn in software. This one is dropped rather than
+                        // updating the game a second time to draw it again.
+                        if (use_geometry && !DrawGeometry(renderer, &geometry_textures, &geometry_buffer)) {
+                            SDL_Log("Unable to draw the geometry, drawing in software. %s\n", SDL_GetError());
+                            use_geometry = false;
+                            skip_present = true;
+                        }
+#endif
+
+                        if (!use_geometry && !skip_present) {
+                            // Only the part of the texture the frame covers is uploaded and drawn.
+                            SDL_Rect frame_rect = { 0, 0, offscreen_buffer->width, offscreen_buffer->height };
+
+                            u64 upload_begin = SDL_GetPerformanceCounter();
+                            SDL_UpdateTexture(texture, &frame_rect, offscreen_buffer->pixels, offscreen_buffer->pitch);
+                            upload_time += SDL_GetPerformanceCounter() - upload_begin;
+                            upload_count += 1;
+
+                            if (upload_count == UPLOAD_TIMING_FRAMES) {
+                                SDL_Log("Texture upload: %.3f ms\n", (f64)upload_time * 1000.0 / (f64)frequency / (f64)upload_count);
+                                upload_time  = 0;
+                                upload_count = 0;
+                            }
+                            SDL_RenderCopy(renderer, texture, &frame_rect, NULL);
+                        }
+
+                        if (!skip_present) {
+                            SDL_RenderPresent(renderer);
+                        }
 
-                    CloseAudio(audio_buffer);
+                        offscreen_buffers.current = (current + 1) % OFFSCREEN_BUFFER_COUNT;
+                    }
                 } else {
                     SDL_Log("Unable to initialise audio. %s\n", SDL_GetError());
                 }
 
+                CloseAudio(audio_device, &audio_ring);
+
+                // Background jobs work out of the game's memory.
+                CompleteRemainingWork(&background_queue);
+
                 FreeMemory(memory);
             } else {
                 SDL_Log("Unable to allocate memory.");
             }
 
-            SDL_DestroyTexture(texture);
+#if HAS_GEOMETRY_BACKEND
+            FreeGeometryTextures(&geometry_textures);
+#endif
+            FreeOffscreenBuffers(&offscreen_buffers);
             SDL_DestroyRenderer(renderer);
             SDL_DestroyWindow(window);
         } else {
@@ -600,11 +1457,16 @@ i32 main(i32 argc, char** argv) {
             SDL_SemPost(job_queue.semaphore);
         }
 
+        SDL_SemPost(background_queue.semaphore);
+
         for (u32 i = 0; i < num_cpus; i += 1) {
             SDL_WaitThread(threads[i], NULL);
         }
 
+        SDL_WaitThread(background_thread, NULL);
+
         SDL_DestroySemaphore(job_queue.semaphore);
+        SDL_DestroySemaphore(background_queue.semaphore);
 
         StackFree(threads);
         StackFree(thread_infos);
@@ -613,5 +1475,5 @@ i32 main(i32 argc, char** argv) {
     }
 
     SDL_Quit();
-    return(EXIT_SUCCESS);
+    return(exit_code);
 }
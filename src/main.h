@@ -13,6 +13,18 @@ u32  CpuCoreCount         (struct JobQueue* queue);
 void PushJob              (struct JobQueue* queue, void* data, WorkerFn worker_fn);
 void CompleteRemainingWork(struct JobQueue* queue);
 
+// A store is seen by another thread's load, along with every write made before
+// it, for handing work over without a lock.
+u32  AtomicLoad           (volatile u32* value);
+void AtomicStore          (volatile u32* value, u32 new_value);
+
+// ==============================================
+// Timing
+
+// An opaque timestamp, only meaningful relative to another one.
+u64 GetWallClock     (void);
+f32 GetSecondsElapsed(u64 begin, u64 end);
+
 // ==============================================
 // File IO
 
@@ -24,6 +36,17 @@ struct DebugFile {
 struct DebugFile DebugOpenFile(char* filename);
 void             DebugCloseFile(struct DebugFile);
 
+// For files too big to load whole, read a piece at a time. Reads can come
+// from any thread, but only one at a time per stream.
+struct DebugStream {
+    u64   size;
+    void* handle;
+};
+
+struct DebugStream DebugOpenStream (char* filename);
+u64                DebugReadStream (struct DebugStream stream, u64 offset, void* buffer, u64 size);
+void               DebugCloseStream(struct DebugStream stream);
+
 // ==============================================
 // Update and Render
 
@@ -40,6 +63,8 @@ struct ButtonState {
 };
 
 struct InputState {
+    f32                seconds_per_frame;
+
     i32                mouse_x;
     i32                mouse_y;
     bool               mouse_double_click;
@@ -56,12 +81,73 @@ struct InputState {
     struct ButtonState escape;          // escape
 };
 
+// The packed 32 bit layouts the game can render in, named from the most
+// significant byte down like SDL does. The game works in ARGB and converts to
+// the buffer's format at the last moment.
+enum PixelFormat {
+    PixelFormatARGB8888,
+    PixelFormatABGR8888,
+    PixelFormatRGBA8888,
+    PixelFormatBGRA8888,
+
+    PixelFormatCount,
+};
+
 struct OffscreenBuffer {
-    void* pixels;
-    u32   bytes_per_pixel;
-    i32   pitch;
-    i32   width;
-    i32   height;
+         void*       pixels;
+         u32         bytes_per_pixel;
+    enum PixelFormat format;
+         i32         pitch;
+         i32         width;
+         i32         height;
+};
+
+// Instead of filling an offscreen buffer the game can describe the frame as
+// triangles, for platforms that would rather have the GPU do the filling.
+//
+// Vertices are laid out like SDL_Vertex so they can be handed straight over,
+// their colours are bytes in RGBA order.
+struct GeometryVertex {
+    f32 x;
+    f32 y;
+    u32 colour;
+    f32 u;
+    f32 v;
+};
+
+// An image the platform uploads once and keeps until `version` changes. Pixels
+// are packed like the vertex colours, with no padding between rows.
+struct GeometryTexture {
+    u32* pixels;
+    i32  width;
+    i32  height;
+    u32  version;
+};
+
+enum GeometryBlend {
+    GeometryBlendAlpha,
+    GeometryBlendAdd,
+};
+
+// One draw call, a run of indices that share a texture and blend mode.
+struct GeometryBatch {
+    struct GeometryTexture* texture; // NULL for flat colour.
+      enum GeometryBlend    blend;
+           u32              first_index;
+           u32              index_count;
+};
+
+// Everything points into the game's memory and is only valid until the next
+// call to UpdateAndRender.
+struct GeometryBuffer {
+           u32              clear_colour; // ARGB.
+
+    struct GeometryVertex*  vertices;
+           u32              vertex_count;
+           i32*             indices;
+           u32              index_count;
+    struct GeometryBatch*   batches;
+           u32              batch_count;
 };
 
 struct AudioBuffer {
@@ -75,10 +161,21 @@ struct AudioBuffer {
 // Provided by the game
 // ==============================================
 
+// When `geometry_buffer` isn't NULL the frame goes there instead, and only the
+// size of the offscreen buffer is used. Jobs pushed to `background_queue` can
+// take many frames, the game never waits on them to finish a frame.
 void UpdateAndRender(
     struct Memory*          memory,
     struct InputState*      input_state,
     struct JobQueue*        queue,
+    struct JobQueue*        background_queue,
     struct OffscreenBuffer* offscreen_buffer,
+    struct GeometryBuffer*  geometry_buffer,
     struct AudioBuffer*     audio_buffer
 );
+
+// Mixes a fixed script of sound events into `audio_buffer`, as many frames as
+// it holds, without a device. The same length always gives the same samples,
+// so changes to the mixer can be checked against a recording. `memory` is the
+// script's own, not the game's. Returns the seconds spent mixing.
+f32 RenderAudioScript(struct Memory* memory, struct AudioBuffer* audio_buffer);
@@ -6,3 +6,30 @@
 #define Clamp(value, min, max) Max(Min(value, max), min)
 
 #define PI 3.1415927410125732421875f
+
+// Rounds towards negative infinity, unlike C's division which rounds towards zero.
+#define FloorDiv(a, b) (((a) < 0) ? -((-(a) + (b) - 1) / (b)) : (a) / (b))
+
+#define Abs(value)  ((value) < 0 ? -(value) : (value))
+#define Sign(value) (((value) > 0) - ((value) < 0))
+
+// Xorshift, fast and good enough for gameplay. The state must never be zero.
+u32 NextRandom(u32* state) {
+    u32 x = *state;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+
+    *state = x;
+    return(x);
+}
+
+// Splits a volume between left and right so the total power stays the same
+// wherever it is panned. -1 is hard left, 1 is hard right.
+void ConstantPowerPan(f32 volume, f32 pan, f32* left, f32* right) {
+    f32 angle = (Clamp(pan, -1.0f, 1.0f) + 1.0f) * 0.25f * PI;
+
+    *left  = volume * cosf(angle);
+    *right = volume * sinf(angle);
+}
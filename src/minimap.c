@@ -0,0 +1,72 @@
+// ==============================================
+// Minimap
+// ==============================================
+
+void InitMinimap(struct Minimap* minimap, struct TileMap* map, struct MemoryArena* arena) {
+    InitSpriteAtlas(&minimap->image, map->width * MINIMAP_TILE_PIXELS, map->height * MINIMAP_TILE_PIXELS, arena);
+
+    minimap->revealed     = PushArray(arena, bool, map->width * map->height);
+    minimap->changes_seen = map->change_count;
+
+    for (u32 i = 0; i < map->width * map->height; i += 1) {
+        minimap->revealed[i] = false;
+    }
+}
+
+void DrawMinimapTile(struct Minimap* minimap, struct TileMap* map, i32 x, i32 y) {
+    struct SpriteAtlas* image  = &minimap->image;
+           u8           colour = tile_infos[GetTile(map, x, y)].colour;
+
+    u8* row = image->pixels + x * MINIMAP_TILE_PIXELS + y * MINIMAP_TILE_PIXELS * image->pitch;
+
+    for (u32 i = 0; i < MINIMAP_TILE_PIXELS; i += 1) {
+        memset(row, colour, MINIMAP_TILE_PIXELS);
+        row += image->pitch;
+    }
+
+    image->version += 1;
+}
+
+// Redraws the revealed tiles that changed since the last update, then reveals
+// whatever the player can see now. Both only touch a handful of tiles, unless
+// so much has changed that the log has wrapped, then every revealed tile is
+// redrawn.
+void UpdateMinimap(struct Minimap* minimap, struct TileMap* map, struct Visibility* fov) {
+    u32 change_count = map->change_count - minimap->changes_seen;
+
+    if (change_count > TILE_CHANGE_LOG_SIZE) {
+        for (u32 y = 0; y < map->height; y += 1) {
+            for (u32 x = 0; x < map->width; x += 1) {
+                if (minimap->revealed[x + y * map->width]) {
+                    DrawMinimapTile(minimap, map, x, y);
+                }
+            }
+        }
+    } else {
+        for (u32 i = minimap->changes_seen; i != map->change_count; i += 1) {
+            struct TileChange* change = &map->changes[i & (TILE_CHANGE_LOG_SIZE - 1)];
+
+            if (minimap->revealed[change->x + change->y * map->width]) {
+                DrawMinimapTile(minimap, map, change->x, change->y);
+            }
+        }
+    }
+
+    minimap->changes_seen = map->change_count;
+
+    i32 min_x = Max(fov->origin_x - fov->radius, 0);
+    i32 min_y = Max(fov->origin_y - fov->radius, 0);
+    i32 max_x = Min(fov->origin_x + fov->radius, (i32)map->width  - 1);
+    i32 max_y = Min(fov->origin_y + fov->radius, (i32)map->height - 1);
+
+    for (i32 y = min_y; y <= max_y; y += 1) {
+        for (i32 x = min_x; x <= max_x; x += 1) {
+            bool* revealed = &minimap->revealed[x + y * map->width];
+
+            if (!*revealed && CanSee(fov, x, y)) {
+                *revealed = true;
+                DrawMinimapTile(minimap, map, x, y);
+            }
+        }
+    }
+}
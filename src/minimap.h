@@ -0,0 +1,16 @@
+// ==============================================
+// Minimap
+// ==============================================
+
+#define MINIMAP_TILE_PIXELS 2
+
+// The whole map at a couple of pixels per tile, as palette indices so it can be
+// drawn like any other image. Tiles stay transparent until the player has seen
+// them, and after that are only redrawn when the map says they changed.
+struct Minimap {
+    struct SpriteAtlas image;
+           bool*       revealed;
+
+    // Where in the tile map's change log this was last brought up to date.
+           u32         changes_seen;
+};
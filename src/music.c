@@ -0,0 +1,298 @@
+// ==============================================
+// Music
+// ==============================================
+
+void InitMusicStream(struct MusicStream* music, struct MemoryArena* arena, struct JobQueue* queue) {
+    *music = (struct MusicStream){};
+
+    music->queue = queue;
+
+    // Big enough for stereo, whatever the track turns out to be.
+    music->read_buffer      = PushArray(arena, u8,  MUSIC_READ_BUFFER_SIZE);
+    music->ring.samples     = PushArray(arena, i16, (MUSIC_RING_FRAMES + 1) * 2);
+    music->ring.frame_count = MUSIC_RING_FRAMES;
+}
+
+// ==============================================
+// Decoding
+
+static i32 adpcm_step_sizes[89] = {
+        7,     8,     9,    10,    11,    12,    13,    14,    16,    17,
+       19,    21,    23,    25,    28,    31,    34,    37,    41,    45,
+       50,    55,    60,    66,    73,    80,    88,    97,   107,   118,
+      130,   143,   157,   173,   190,   209,   230,   253,   279,   307,
+      337,   371,   408,   449,   494,   544,   598,   658,   724,   796,
+      876,   963,  1060,  1166,  1282,  1411,  1552,  1707,  1878,  2066,
+     2272,  2499,  2749,  3024,  3327,  3660,  4026,  4428,  4871,  5358,
+     5894,  6484,  7132,  7845,  8630,  9493, 10442, 11487, 12635, 13899,
+    15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767,
+};
+
+static i32 adpcm_index_changes[16] = {
+    -1, -1, -1, -1, 2, 4, 6, 8,
+    -1, -1, -1, -1, 2, 4, 6, 8,
+};
+
+struct AdpcmChannel {
+    i32 predictor;
+    i32 step_index;
+};
+
+i16 DecodeAdpcmNibble(struct AdpcmChannel* channel, u32 nibble) {
+    i32 step       = adpcm_step_sizes[channel->step_index];
+    i32 difference = step >> 3;
+
+    if (nibble & 1) difference += step >> 2;
+    if (nibble & 2) difference += step >> 1;
+    if (nibble & 4) difference += step;
+    if (nibble & 8) difference  = -difference;
+
+    channel->predictor  = Clamp(channel->predictor + difference, -32768, 32767);
+    channel->step_index = Clamp(channel->step_index + adpcm_index_changes[nibble], 0, 88);
+
+    return((i16)channel->predictor);
+}
+
+// Each channel's block starts with a header holding its first sample. After
+// the headers the channels take turns with 4 bytes, 8 samples, at a time, low
+// nibble first.
+void DecodeAdpcmBlock(struct MusicStream* music, u8* block) {
+    u32  channels = music->channel_count;
+    u32  mask     = MUSIC_RING_FRAMES - 1;
+    u64  first    = music->decoded_frames;
+    i16* samples  = music->ring.samples;
+
+    for (u32 channel = 0; channel < channels; channel += 1) {
+        u8* header = block + channel * 4;
+
+        struct AdpcmChannel state = {
+            .predictor  = (i16)ReadU16(header),
+            .step_index = Min(header[2], 88),
+        };
+
+        samples[(first & mask) * channels + channel] = (i16)state.predictor;
+
+        u32 frame = 1;
+
+        for (u32 group = 0; frame < music->frames_per_block; group += 1) {
+            u8* bytes = block + channels * 4 + (group * channels + channel) * 4;
+
+            for (u32 i = 0; i < 8; i += 1) {
+                u32 nibble = (bytes[i / 2] >> ((i & 1) * 4)) & 0xF;
+
+                samples[((first + frame) & mask) * channels + channel] = DecodeAdpcmNibble(&state, nibble);
+                frame += 1;
+            }
+        }
+    }
+
+    music->decoded_frames += music->frames_per_block;
+}
+
+// Reads and decodes blocks until the ring is full or the track has ended,
+// going back to the start of the track when it loops.
+void ThreadDecodeMusic(void* data) {
+    struct MusicStream* music = (struct MusicStream*)data;
+
+    u32  channels = music->channel_count;
+    u32  mask     = MUSIC_RING_FRAMES - 1;
+    bool done     = false;
+
+    while (!done) {
+        u32 buffered    = (u32)music->decoded_frames - AtomicLoad(&music->played_frames);
+        u32 free_blocks = (MUSIC_RING_FRAMES - buffered) / music->frames_per_block;
+        u32 run         = Min(Min(free_blocks, MUSIC_READ_BUFFER_SIZE / music->block_align), music->block_count - music->next_block);
+        u64 bytes       = (u64)run * music->block_align;
+        u64 read        = DebugReadStream(music->file, music->data_offset + (u64)music->next_block * music->block_align, music->read_buffer, bytes);
+        u32 got         = (u32)(read / music->block_align);
+
+        for (u32 i = 0; i < got; i += 1) {
+            u32 first = (u32)music->decoded_frames & mask;
+
+            DecodeAdpcmBlock(music, music->read_buffer + i * music->block_align);
+
+            // The guard frame, see struct Sound. It has to be right before
+            // the mixer can blend into it.
+            if (first == 0 || first + music->frames_per_block > MUSIC_RING_FRAMES) {
+                for (u32 channel = 0; channel < channels; channel += 1) {
+                    music->ring.samples[MUSIC_RING_FRAMES * channels + channel] = music->ring.samples[channel];
+                }
+            }
+
+            AtomicStore(&music->published_frames, (u32)music->decoded_frames);
+        }
+
+        music->next_block += got;
+
+        // A read that comes up short is treated like the end of the track.
+        if (got < run) {
+            AtomicStore(&music->finished, 1);
+        } else if (music->next_block == music->block_count) {
+            music->next_block = 0;
+
+            if (!music->looping) {
+                AtomicStore(&music->finished, 1);
+            }
+        }
+
+        done = run == 0 || AtomicLoad(&music->finished);
+    }
+
+    AtomicStore(&music->job_running, 0);
+}
+
+// ==============================================
+// Playback
+
+// Reads the chunk headers one at a time, so only the few bytes that matter are
+// ever loaded.
+bool ParseMusicHeader(struct MusicStream* music) {
+    struct DebugStream file = music->file;
+
+    u8   riff[12];
+    bool valid        = DebugReadStream(file, 0, riff, 12) == 12 && memcmp(riff, "RIFF", 4) == 0 && memcmp(riff + 8, "WAVE", 4) == 0;
+    bool found_format = false;
+    bool found_data   = false;
+    u64  offset       = 12;
+
+    while (valid && !found_data && offset + 8 <= file.size) {
+        u8 chunk[8];
+        valid = DebugReadStream(file, offset, chunk, 8) == 8;
+
+        u64 chunk_size = ReadU32(chunk + 4);
+        u64 available  = file.size - offset - 8;
+
+        if (valid && memcmp(chunk, "fmt ", 4) == 0) {
+            u8 format[20];
+            valid = chunk_size >= 20 && DebugReadStream(file, offset + 8, format, 20) == 20;
+
+            if (valid) {
+                music->channel_count      = ReadU16(format + 2);
+                music->samples_per_second = ReadU32(format + 4);
+                music->block_align        = ReadU16(format + 12);
+                music->frames_per_block   = ReadU16(format + 18);
+
+                u32 channels        = music->channel_count;
+                u32 encoding        = ReadU16(format + 0);
+                u32 bits_per_sample = ReadU16(format + 14);
+
+                valid = encoding == 0x11
+                     && bits_per_sample == 4
+                     && (channels == 1 || channels == 2)
+                     && music->samples_per_second > 0
+                     && music->block_align > channels * 4
+                     && music->block_align % (channels * 4) == 0
+                     && music->block_align <= MUSIC_READ_BUFFER_SIZE
+                     && music->frames_per_block == (music->block_align - channels * 4) * 2 / channels + 1
+                     && music->frames_per_block <= MUSIC_RING_FRAMES / 4;
+
+                found_format = valid;
+            }
+        } else if (valid && memcmp(chunk, "data", 4) == 0) {
+            // A part block at the end is dropped.
+            valid = found_format;
+
+            if (valid) {
+                music->data_offset = offset + 8;
+                music->block_count = (u32)(Min(chunk_size, available) / music->block_align);
+
+                found_data = music->block_count > 0;
+                valid      = found_data;
+            }
+        }
+
+        // Chunks are padded to an even size.
+        offset += 8 + chunk_size + (chunk_size & 1);
+    }
+
+    return(valid && found_data);
+}
+
+void StopMusic(struct MusicStream* music) {
+    // The job may still be reading from the file.
+    if (AtomicLoad(&music->job_running)) {
+        CompleteRemainingWork(music->queue);
+    }
+
+    DebugCloseStream(music->file);
+
+    music->file    = (struct DebugStream){};
+    music->playing = false;
+}
+
+bool PlayMusic(struct MusicStream* music, struct Mixer* mixer, char* filename, f32 volume, bool looping) {
+    StopMusic(music);
+
+    music->file    = DebugOpenStream(filename);
+    music->playing = ParseMusicHeader(music);
+
+    if (music->playing) {
+        music->looping          = looping;
+        music->next_block       = 0;
+        music->decoded_frames   = 0;
+        music->position         = 0;
+        music->finished         = 0;
+        music->published_frames = 0;
+        music->played_frames    = 0;
+
+        music->ring.channel_count      = music->channel_count;
+        music->ring.samples_per_second = music->samples_per_second;
+
+        music->voice = (struct Voice){
+            .sound       = &music->ring,
+            .step        = VoiceStep(mixer, &music->ring, 1.0f),
+            .volume      = volume,
+            .pitch       = 1.0f,
+            .looping     = true,
+            .attenuation = 1.0f,
+        };
+
+        UpdateVoiceGains(&music->voice);
+    } else {
+        StopMusic(music);
+    }
+
+    return(music->playing);
+}
+
+// Tops the ring up once half of it has played, so the job wakes every few
+// frames rather than for a block or two every frame. Nothing waits on the job,
+// the mixer plays whatever it has published so far.
+void UpdateMusic(struct MusicStream* music) {
+    if (music->playing && !AtomicLoad(&music->finished) && !AtomicLoad(&music->job_running)) {
+        u32 buffered = AtomicLoad(&music->published_frames) - music->played_frames;
+
+        if (MUSIC_RING_FRAMES - buffered >= MUSIC_RING_FRAMES / 2) {
+            music->job_running = 1;
+            PushJob(music->queue, music, ThreadDecodeMusic);
+        }
+    }
+}
+
+// Plays as much as has been published. Blending reads the frame after the one
+// it is on, so that has to have been published too. The end of the track is
+// checked first, so every frame is in by the time it is seen.
+void MixMusic(struct MusicStream* music, f32* out, u32 frame_count) {
+    if (music->playing) {
+        bool finished = AtomicLoad(&music->finished);
+        u32  buffered = AtomicLoad(&music->published_frames) - music->played_frames;
+
+        u64 step     = music->voice.step;
+        u64 position = music->position;
+        u64 fraction = position & 0xFFFFFFFF;
+        u64 end      = (buffered > 0) ? (u64)(buffered - 1) << VOICE_FRACTION_BITS : 0;
+        u64 room     = (end > fraction) ? end - fraction : 0;
+        u32 count    = (u32)Min((u64)frame_count, room / step);
+        u64 frame    = (position >> VOICE_FRACTION_BITS) & (MUSIC_RING_FRAMES - 1);
+
+        music->voice.position = (frame << VOICE_FRACTION_BITS) | fraction;
+        MixVoice(&music->voice, out, count);
+
+        music->position += step * count;
+        AtomicStore(&music->played_frames, (u32)(music->position >> VOICE_FRACTION_BITS));
+
+        if (finished && count < frame_count) {
+            StopMusic(music);
+        }
+    }
+}
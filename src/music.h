@@ -0,0 +1,56 @@
+// ==============================================
+// Music
+// ==============================================
+
+// Decoded frames kept ahead of the mixer, about a third of a second at 48 kHz.
+// A power of two, so positions wrap with a mask.
+#define MUSIC_RING_FRAMES 16384
+
+// Compressed bytes read from the file at a time.
+#define MUSIC_READ_BUFFER_SIZE 16384
+
+// Music is streamed from IMA ADPCM WAV files, a quarter the size of 16 bit
+// PCM and cheap to decode. The file is read and decoded on a background job
+// into a ring, which the mixer plays through like any looping sound.
+//
+// The job can take as many frames as the disk needs. It decodes into the part
+// of the ring the mixer is done with and publishes each block as it finishes,
+// and the mixer only plays what has been published. Each side publishes how
+// far it has got with AtomicStore, and the other only reads that with
+// AtomicLoad.
+struct MusicStream {
+    struct DebugStream file;
+    struct JobQueue*   queue;
+           bool        playing;
+           bool        looping;
+
+           u32         channel_count;
+           u32         samples_per_second;
+           u32         block_align;
+           u32         frames_per_block;
+           u64         data_offset;
+           u32         block_count;
+
+           u8*         read_buffer;
+
+    // The ring as a sound, so the mixer's resampling plays it. It has the
+    // usual guard frame, kept as a copy of the first.
+    struct Sound       ring;
+           u64         position; // 32.32, counting from the start of playback.
+    struct Voice       voice;
+
+    // Only touched by the job.
+           u32         next_block;
+           u64         decoded_frames;
+
+    // Shared between the job and the mixer. Frame counts wrap, only the
+    // difference between two of them means anything.
+    volatile u32       job_running;
+    volatile u32       finished;         // Every block has been published.
+    volatile u32       published_frames; // Decoded, for the mixer to play.
+    volatile u32       played_frames;    // Played, for the job to overwrite.
+};
+
+// The mixer plays the music along with its voices, but audio.c comes first in
+// the build.
+void MixMusic(struct MusicStream* music, f32* out, u32 frame_count);
@@ -0,0 +1,62 @@
+// ==============================================
+// Palette
+// ==============================================
+
+// Everything the game draws is a palette index, the actual colours are only
+// looked up when a frame is written out. That way effects that recolour the
+// whole screen only touch these 256 entries.
+enum PaletteColour {
+    ColourBlack,
+    ColourWhite,
+    ColourFence,
+    ColourGatePost,
+    ColourBalcony,
+    ColourStairsUp,
+    ColourStairsDown,
+    ColourRunningTrack,
+    ColourHallway,
+    ColourClassRoom,
+    ColourLibrary,
+    ColourDirt,
+    ColourGrass,
+    ColourPentagramEdge,
+    ColourPentagramLine,
+    ColourPentagramCentre,
+    ColourStreet,
+    ColourStreetLine,
+    ColourWall,
+    ColourPlayer,
+    ColourDemon,
+    ColourDemonHunting,
+
+    PaletteColourCount,
+};
+
+struct Palette {
+    u32 colours[256];
+};
+
+static u32 base_palette[PaletteColourCount] = {
+    [ColourBlack]           = ARGB(0xFF,   0,   0,   0),
+    [ColourWhite]           = ARGB(0xFF, 255, 255, 255),
+    [ColourFence]           = ARGB(0xFF,  90,  90,  96),
+    [ColourGatePost]        = ARGB(0xFF, 120, 110, 100),
+    [ColourBalcony]         = ARGB(0xFF, 130, 120, 100),
+    [ColourStairsUp]        = ARGB(0xFF, 150, 150, 150),
+    [ColourStairsDown]      = ARGB(0xFF, 100, 100, 100),
+    [ColourRunningTrack]    = ARGB(0xFF, 170,  80,  60),
+    [ColourHallway]         = ARGB(0xFF, 180, 170, 150),
+    [ColourClassRoom]       = ARGB(0xFF, 150, 110,  70),
+    [ColourLibrary]         = ARGB(0xFF, 110,  60,  60),
+    [ColourDirt]            = ARGB(0xFF, 120,  95,  60),
+    [ColourGrass]           = ARGB(0xFF,  60, 120,  50),
+    [ColourPentagramEdge]   = ARGB(0xFF, 120,  20,  20),
+    [ColourPentagramLine]   = ARGB(0xFF, 140,  20,  20),
+    [ColourPentagramCentre] = ARGB(0xFF, 180,  30,  30),
+    [ColourStreet]          = ARGB(0xFF,  50,  50,  55),
+    [ColourStreetLine]      = ARGB(0xFF, 200, 190,  90),
+    [ColourWall]            = ARGB(0xFF, 160, 150, 140),
+    [ColourPlayer]          = ARGB(0xFF, 220, 230, 255),
+    [ColourDemon]           = ARGB(0xFF, 140,  30,  60),
+    [ColourDemonHunting]    = ARGB(0xFF, 255,  40,  40),
+};
@@ -0,0 +1,345 @@
+// ==============================================
+// Particles
+// ==============================================
+
+void InitParticleSystem(struct ParticleSystem* system, u32 capacity, struct MemoryArena* arena) {
+    Assert((capacity & 3) == 0);
+
+    system->count        = 0;
+    system->capacity     = capacity;
+    system->x            = PushArray(arena, f32, capacity);
+    system->y            = PushArray(arena, f32, capacity);
+    system->velocity_x   = PushArray(arena, f32, capacity);
+    system->velocity_y   = PushArray(arena, f32, capacity);
+    system->life         = PushArray(arena, f32, capacity);
+    system->colour       = PushArray(arena, u32, capacity);
+    system->gravity      = 0.0f;
+    system->drag         = 0.0f;
+    system->fade_seconds = 0.5f;
+}
+
+f32 RandomUnilateral(u32* random_state) {
+    return((f32)(NextRandom(random_state) >> 8) * (1.0f / (f32)(1 << 24)));
+}
+
+f32 RandomBilateral(u32* random_state) {
+    return(RandomUnilateral(random_state) * 2.0f - 1.0f);
+}
+
+// Spawns `count` particles around a point, with random velocities up to `speed`
+// added on to `velocity`. Anything past the capacity is dropped.
+void EmitParticles(
+    struct ParticleSystem* system,
+    u32*                   random_state,
+    u32                    count,
+    f32 x, f32 y,
+    f32 velocity_x, f32 velocity_y,
+    f32 speed, f32 life, u32 colour
+) {
+    count = Min(count, system->capacity - system->count);
+
+    for (u32 i = 0; i < count; i += 1) {
+        u32 index = system->count++;
+
+        system->x         [index] = x;
+        system->y         [index] = y;
+        system->velocity_x[index] = velocity_x + RandomBilateral(random_state) * speed;
+        system->velocity_y[index] = velocity_y + RandomBilateral(random_state) * speed;
+        system->life      [index] = life * (0.5f + 0.5f * RandomUnilateral(random_state));
+        system->colour    [index] = colour;
+    }
+}
+
+// ==============================================
+// Simulation
+
+struct ParticleUpdateJob {
+    struct ParticleSystem* system;
+           u32             begin;
+           u32             end;
+           f32             seconds;
+           u32             alive_count;
+};
+
+#define CompactParticleArray(array) array[write] = array[read]
+
+void ThreadUpdateParticles(void* data) {
+    struct ParticleUpdateJob* job    = (struct ParticleUpdateJob*)data;
+    struct ParticleSystem*    system = job->system;
+
+    __m128 seconds = _mm_set1_ps(job->seconds);
+    __m128 gravity = _mm_set1_ps(system->gravity * job->seconds);
+    __m128 drag    = _mm_set1_ps(Max(1.0f - system->drag * job->seconds, 0.0f));
+
+    // Ranges always start on a multiple of 4 and the last one is rounded up to a
+    // multiple of 4, running over the end of the live particles is harmless.
+    for (u32 i = job->begin; i < job->end; i += 4) {
+        __m128 x          = _mm_load_ps(system->x          + i);
+        __m128 y          = _mm_load_ps(system->y          + i);
+        __m128 velocity_x = _mm_load_ps(system->velocity_x + i);
+        __m128 velocity_y = _mm_load_ps(system->velocity_y + i);
+        __m128 life       = _mm_load_ps(system->life       + i);
+
+        velocity_y = _mm_add_ps(velocity_y, gravity);
+        velocity_x = _mm_mul_ps(velocity_x, drag);
+        velocity_y = _mm_mul_ps(velocity_y, drag);
+
+        x    = _mm_add_ps(x, _mm_mul_ps(velocity_x, seconds));
+        y    = _mm_add_ps(y, _mm_mul_ps(velocity_y, seconds));
+        life = _mm_sub_ps(life, seconds);
+
+        _mm_store_ps(system->x          + i, x);
+        _mm_store_ps(system->y          + i, y);
+        _mm_store_ps(system->velocity_x + i, velocity_x);
+        _mm_store_ps(system->velocity_y + i, velocity_y);
+        _mm_store_ps(system->life       + i, life);
+    }
+
+    // Squeeze the survivors to the front of this job's range, in order.
+    u32 write = job->begin;
+
+    for (u32 read = job->begin; read < Min(job->end, system->count); read += 1) {
+        if (system->life[read] > 0.0f) {
+            CompactParticleArray(system->x);
+            CompactParticleArray(system->y);
+            CompactParticleArray(system->velocity_x);
+            CompactParticleArray(system->velocity_y);
+            CompactParticleArray(system->life);
+            CompactParticleArray(system->colour);
+            write += 1;
+        }
+    }
+
+    job->alive_count = write - job->begin;
+}
+
+#define MoveParticleArray(array) memmove(array + to, array + from, count * sizeof(array[0]))
+
+void UpdateParticles(struct ParticleSystem* system, f32 seconds, struct JobQueue* queue, struct MemoryArena* arena) {
+    u32 per_job   = 8192;
+    u32 job_count = Clamp((system->count + per_job - 1) / per_job, 1, Min(CpuCoreCount(queue) * 2, MAX_PARTICLE_UPDATE_JOBS));
+
+    // Keep every range starting on a multiple of 4 for the aligned loads.
+    u32 padded_count = (system->count + 3) & ~3;
+    per_job          = (((padded_count + job_count - 1) / job_count) + 3) & ~3;
+
+    struct ParticleUpdateJob* jobs = PushArray(arena, struct ParticleUpdateJob, job_count);
+
+    for (u32 i = 0; i < job_count; i += 1) {
+        struct ParticleUpdateJob* job = &jobs[i];
+
+        job->system  = system;
+        job->begin   = Min(i * per_job, padded_count);
+        job->end     = Min(job->begin + per_job, padded_count);
+        job->seconds = seconds;
+
+        PushJob(queue, job, ThreadUpdateParticles);
+    }
+
+    CompleteRemainingWork(queue);
+
+    // Each job compacted its own range, now close the gaps between the ranges.
+    u32 to = 0;
+
+    for (u32 i = 0; i < job_count; i += 1) {
+        u32 from  = jobs[i].begin;
+        u32 count = jobs[i].alive_count;
+
+        if (from != to && count > 0) {
+            MoveParticleArray(system->x);
+            MoveParticleArray(system->y);
+            MoveParticleArray(system->velocity_x);
+            MoveParticleArray(system->velocity_y);
+            MoveParticleArray(system->life);
+            MoveParticleArray(system->colour);
+        }
+
+        to += count;
+    }
+
+    system->count = to;
+}
+
+// ==============================================
+// Rendering
+
+// Binning works like a radix sort pass with the render tile as the digit: each
+// job counts how many fragments it has for each tile, the counts are turned into
+// offsets and then each job scatters its fragments into place.
+struct ParticleBinJob {
+    struct ParticlePass*      pass;
+    struct TileLayout*        layout;
+           u32                begin;
+           u32                end;
+           u32*               counts;
+    struct ParticleFragment*  fragments;
+      enum PixelFormat        format;
+
+    // The tile column of every pixel column and the tile row of every pixel
+    // row, so finding a particle's tiles doesn't divide.
+           u8*                tile_columns;
+           u8*                tile_rows;
+};
+
+// Calls `body` once for every tile the particle at `index` touches.
+#define ForEachParticleTile(job, index, body) {                                                  \
+    struct ParticleSystem* system = (job)->pass->system;                                        \
+    struct Rect            area   = {                                                           \
+        (i32)system->x[index] - (job)->pass->camera_x,                                          \
+        (i32)system->y[index] - (job)->pass->camera_y,                                          \
+        PARTICLE_SIZE_PIXELS,                                                                   \
+        PARTICLE_SIZE_PIXELS,                                                                   \
+    };                                                                                          \
+    struct Rect screen = { 0, 0, (job)->layout->width, (job)->layout->height };                 \
+    struct Rect visible;                                                                        \
+                                                                                                \
+    if (IntersectRect(screen, area, &visible)) {                                                \
+        i32 min_x = (job)->tile_columns[visible.x];                                             \
+        i32 min_y = (job)->tile_rows   [visible.y];                                             \
+        i32 max_x = (job)->tile_columns[visible.x + visible.w - 1];                             \
+        i32 max_y = (job)->tile_rows   [visible.y + visible.h - 1];                             \
+                                                                                                \
+        for (i32 tile_y = min_y; tile_y <= max_y; tile_y += 1) {                                \
+            for (i32 tile_x = min_x; tile_x <= max_x; tile_x += 1) {                            \
+                u32 tile = tile_x + tile_y * (job)->layout->tiles_wide;                         \
+                body                                                                            \
+            }                                                                                   \
+        }                                                                                       \
+    }                                                                                           \
+}
+
+void ThreadCountParticles(void* data) {
+    struct ParticleBinJob* job = (struct ParticleBinJob*)data;
+
+    for (u32 i = job->begin; i < job->end; i += 1) {
+        ForEachParticleTile(job, i, { job->counts[tile] += 1; });
+    }
+}
+
+// The particle's colour in ARGB, dimmed as it dies. Alpha is left at zero as the
+// particles are only ever added.
+u32 FadedParticleColour(struct ParticleSystem* system, u32 index, f32 fade_scale) {
+    u32 brightness = (u32)(Clamp(system->life[index] * fade_scale, 0.0f, 1.0f) * 256.0f);
+    u32 colour     = system->colour[index];
+
+    return(
+        (((((colour >> 16) & 0xFF) * brightness) >> 8) << 16) |
+        (((((colour >>  8) & 0xFF) * brightness) >> 8) <<  8) |
+        (((((colour >>  0) & 0xFF) * brightness) >> 8) <<  0)
+    );
+}
+
+void ThreadScatterParticles(void* data) {
+    struct ParticleBinJob* job    = (struct ParticleBinJob*)data;
+    struct ParticleSystem* system = job->pass->system;
+
+    f32 fade_scale = 1.0f / system->fade_seconds;
+
+    for (u32 i = job->begin; i < job->end; i += 1) {
+        u32 colour = ConvertColour(FadedParticleColour(system, i, fade_scale), job->format);
+
+        i16 x = (i16)((i32)system->x[i] - job->pass->camera_x);
+        i16 y = (i16)((i32)system->y[i] - job->pass->camera_y);
+
+        ForEachParticleTile(job, i, {
+            struct ParticleFragment* fragment = &job->fragments[job->counts[tile]++];
+
+            fragment->x      = x;
+            fragment->y      = y;
+            fragment->colour = colour;
+        });
+    }
+}
+
+void BinParticles(
+    struct ParticlePass* pass,
+    struct TileLayout*   layout,
+    struct RenderTile*   tiles,
+      enum PixelFormat   format,
+    struct JobQueue*     queue,
+    struct MemoryArena*  arena
+) {
+    struct ParticleSystem* system = pass->system;
+
+    u32 tile_count = layout->tiles_wide * layout->tiles_high;
+    u32 job_count  = Clamp(system->count / 8192, 1, CpuCoreCount(queue));
+
+    struct ParticleBinJob* jobs = PushArray(arena, struct ParticleBinJob, job_count);
+
+    // Tiles per side are capped well under 256, see MAX_TILES_PER_SIDE.
+    u8* tile_columns = PushArray(arena, u8, layout->width);
+    u8* tile_rows    = PushArray(arena, u8, layout->height);
+
+    for (i32 x = 0; x < layout->width; x += 1) {
+        tile_columns[x] = (u8)Min(x / layout->tile_width, layout->tiles_wide - 1);
+    }
+
+    for (i32 y = 0; y < layout->height; y += 1) {
+        tile_rows[y] = (u8)Min(y / layout->tile_height, layout->tiles_high - 1);
+    }
+
+    for (u32 i = 0; i < job_count; i += 1) {
+        struct ParticleBinJob* job = &jobs[i];
+
+        job->pass         = pass;
+        job->layout       = layout;
+        job->format       = format;
+        job->tile_columns = tile_columns;
+        job->tile_rows    = tile_rows;
+        job->begin        = system->count *  i      / job_count;
+        job->end          = system->count * (i + 1) / job_count;
+        job->counts       = PushArray(arena, u32, tile_count);
+
+        memset(job->counts, 0, tile_count * sizeof(u32));
+
+        PushJob(queue, job, ThreadCountParticles);
+    }
+
+    CompleteRemainingWork(queue);
+
+    u32 total = 0;
+
+    for (u32 tile = 0; tile < tile_count; tile += 1) {
+        tiles[tile].fragment_count = 0;
+
+        for (u32 i = 0; i < job_count; i += 1) {
+            u32 count = jobs[i].counts[tile];
+
+            jobs[i].counts[tile]        = total;
+            tiles[tile].fragment_count += count;
+            total                      += count;
+        }
+    }
+
+    struct ParticleFragment* fragments = PushArray(arena, struct ParticleFragment, total);
+
+    for (u32 tile = 0; tile < tile_count; tile += 1) {
+        tiles[tile].fragments = fragments + (jobs[0].counts[tile]);
+    }
+
+    for (u32 i = 0; i < job_count; i += 1) {
+        jobs[i].fragments = fragments;
+        PushJob(queue, &jobs[i], ThreadScatterParticles);
+    }
+
+    CompleteRemainingWork(queue);
+}
+
+// Additive blend with saturation, so overlapping particles bloom towards white
+// instead of wrapping around.
+void DrawParticleFragments(
+    struct OffscreenBuffer*  buffer,
+    struct Rect              clip,
+    struct ParticleFragment* fragments,
+    u32                      count
+) {
+    for (u32 i = 0; i < count; i += 1) {
+        struct ParticleFragment* fragment = &fragments[i];
+
+        FillRect(
+            buffer, clip,
+            fragment->x, fragment->y, PARTICLE_SIZE_PIXELS, PARTICLE_SIZE_PIXELS,
+            fragment->colour, BlendAdd
+        );
+    }
+}
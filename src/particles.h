@@ -0,0 +1,52 @@
+// ==============================================
+// Particles
+// ==============================================
+
+// Capacity is kept a multiple of 4 so the SIMD update never needs a scalar tail.
+#define MAX_PARTICLES (128 * 1024)
+
+// Every update job is pushed before any are waited on, and the job queue only
+// holds 256 entries.
+#define MAX_PARTICLE_UPDATE_JOBS 64
+
+// Stored as a structure of arrays so the update can load 4 of each field at once.
+// Positions are in world pixels and velocities in pixels per second.
+struct ParticleSystem {
+    u32  count;
+    u32  capacity;
+    f32* x;
+    f32* y;
+    f32* velocity_x;
+    f32* velocity_y;
+    f32* life;
+    u32* colour;
+
+    // Gravity is in pixels per second squared, drag is the fraction of the
+    // velocity lost each second.
+    f32  gravity;
+    f32  drag;
+
+    // Particles dim over the last part of their life.
+    f32  fade_seconds;
+};
+
+// Handed to the renderer, like the lighting pass.
+struct ParticlePass {
+    struct ParticleSystem* system;
+           i32             camera_x;
+           i32             camera_y;
+};
+
+// A particle that has been placed on screen and assigned to a render tile.
+struct ParticleFragment {
+    i16 x;
+    i16 y;
+    u32 colour;
+};
+
+#define PARTICLE_SIZE_PIXELS 2
+
+// The renderer calls these while it works through the tiles, particles.c is
+// included after render.c because it needs the tile layout helpers.
+void BinParticles(struct ParticlePass* pass, struct TileLayout* layout, struct RenderTile* tiles, enum PixelFormat format, struct JobQueue* queue, struct MemoryArena* arena);
+void DrawParticleFragments(struct OffscreenBuffer* buffer, struct Rect clip, struct ParticleFragment* fragments, u32 count);
@@ -0,0 +1,452 @@
+// ==============================================
+// Post Processing
+// ==============================================
+
+void AddPostPass(struct PostProcess* post, enum PostPassType type) {
+    Assert(post->pass_count < MAX_POST_PASSES);
+
+    if (post->pass_count < MAX_POST_PASSES) {
+        struct PostPass* pass = &post->passes[post->pass_count++];
+
+        pass->type         = type;
+        pass->enabled      = true;
+        pass->milliseconds = 0.0f;
+    }
+}
+
+// Every pass is split into bands of rows, one job each.
+struct PostBandJob {
+    void* data;
+    i32   first_row;
+    i32   last_row;
+    u32*  scratch;
+};
+
+void RunPostBands(
+    struct JobQueue*    queue,
+    struct MemoryArena* arena,
+    i32                 row_count,
+    u32                 scratch_size,
+    WorkerFn            worker,
+    void*               data
+) {
+    u32 band_count = Clamp(Min(CpuCoreCount(queue) * 2, MAX_POST_BANDS), 1, (u32)Max(row_count, 1));
+
+    struct PostBandJob* jobs = PushArray(arena, struct PostBandJob, band_count);
+
+    for (u32 i = 0; i < band_count; i += 1) {
+        struct PostBandJob* job = &jobs[i];
+
+        job->data      = data;
+        job->first_row = row_count *  i      / band_count;
+        job->last_row  = row_count * (i + 1) / band_count;
+        job->scratch   = scratch_size ? PushArray(arena, u32, scratch_size) : NULL;
+
+        PushJob(queue, job, worker);
+    }
+
+    CompleteRemainingWork(queue);
+}
+
+// Moves four 16 bit channels a step of `t` quarters of the way from `from` to
+// `to`, for the two pixels in a register.
+__m128i LerpQuarters(__m128i from, __m128i to, __m128i t) {
+    return(_mm_add_epi16(from, _mm_srai_epi16(_mm_mullo_epi16(_mm_sub_epi16(to, from), t), 2)));
+}
+
+// ==============================================
+// Bloom
+
+struct Bloom {
+    struct PostProcess*     post;
+    struct OffscreenBuffer* buffer;
+           u32*             small;
+           u32*             blurred;
+           i32              width;
+           i32              height;
+           u32              threshold;
+};
+
+// Averages each 4x4 block and keeps only what is over the threshold.
+void ThreadBloomDownsample(void* data) {
+    struct PostBandJob* job   = (struct PostBandJob*)data;
+    struct Bloom*       bloom = (struct Bloom*)job->data;
+
+    __m128i threshold = _mm_set1_epi32(bloom->threshold);
+
+    for (i32 y = job->first_row; y < job->last_row; y += 1) {
+        u8* rows = (u8*)bloom->buffer->pixels + y * 4 * bloom->buffer->pitch;
+        i32 pitch = bloom->buffer->pitch;
+
+        for (i32 x = 0; x < bloom->width; x += 1) {
+            __m128i* block = (__m128i*)(rows + x * 16);
+
+            __m128i top    = _mm_avg_epu8(_mm_loadu_si128(block), _mm_loadu_si128((__m128i*)((u8*)block + pitch)));
+            __m128i bottom = _mm_avg_epu8(_mm_loadu_si128((__m128i*)((u8*)block + pitch * 2)), _mm_loadu_si128((__m128i*)((u8*)block + pitch * 3)));
+            __m128i column = _mm_avg_epu8(top, bottom);
+
+            column = _mm_avg_epu8(column, _mm_srli_si128(column, 4));
+            column = _mm_avg_epu8(column, _mm_srli_si128(column, 8));
+
+            bloom->small[x + y * bloom->width] = _mm_cvtsi128_si32(_mm_subs_epu8(column, threshold));
+        }
+    }
+}
+
+// A [1 4 6 4 1] / 16 binomial filter over the channels of four pixels.
+__m128i Binomial5(__m128i a, __m128i b, __m128i c, __m128i d, __m128i e) {
+    __m128i zero   = _mm_setzero_si128();
+    __m128i result[2];
+
+    for (u32 half = 0; half < 2; half += 1) {
+        __m128i wa = half ? _mm_unpackhi_epi8(a, zero) : _mm_unpacklo_epi8(a, zero);
+        __m128i wb = half ? _mm_unpackhi_epi8(b, zero) : _mm_unpacklo_epi8(b, zero);
+        __m128i wc = half ? _mm_unpackhi_epi8(c, zero) : _mm_unpacklo_epi8(c, zero);
+        __m128i wd = half ? _mm_unpackhi_epi8(d, zero) : _mm_unpacklo_epi8(d, zero);
+        __m128i we = half ? _mm_unpackhi_epi8(e, zero) : _mm_unpacklo_epi8(e, zero);
+
+        __m128i sum = _mm_add_epi16(wa, we);
+        sum = _mm_add_epi16(sum, _mm_slli_epi16(_mm_add_epi16(wb, wd), 2));
+        sum = _mm_add_epi16(sum, _mm_add_epi16(_mm_slli_epi16(wc, 2), _mm_slli_epi16(wc, 1)));
+
+        result[half] = _mm_srli_epi16(sum, 4);
+    }
+
+    return(_mm_packus_epi16(result[0], result[1]));
+}
+
+#define LoadPixels(row, x) _mm_loadu_si128((__m128i*)((row) + (x)))
+
+// Reads from `small` and writes to `blurred`. The edges are clamped, so the
+// middle of each row is done four at a time and the ends one at a time.
+void ThreadBloomBlurRows(void* data) {
+    struct PostBandJob* job   = (struct PostBandJob*)data;
+    struct Bloom*       bloom = (struct Bloom*)job->data;
+    i32                 width = bloom->width;
+
+    for (i32 y = job->first_row; y < job->last_row; y += 1) {
+        u32* from = bloom->small   + y * width;
+        u32* to   = bloom->blurred + y * width;
+        i32  x    = 0;
+
+        for (; x < width; x += 1) {
+            if (x >= 2 && x + 6 <= width) {
+                __m128i result = Binomial5(
+                    LoadPixels(from, x - 2), LoadPixels(from, x - 1), LoadPixels(from, x),
+                    LoadPixels(from, x + 1), LoadPixels(from, x + 2)
+                );
+
+                _mm_storeu_si128((__m128i*)(to + x), result);
+                x += 3;
+            } else {
+                __m128i taps[5];
+
+                for (i32 i = 0; i < 5; i += 1) {
+                    taps[i] = _mm_cvtsi32_si128(from[Clamp(x + i - 2, 0, width - 1)]);
+                }
+
+                to[x] = _mm_cvtsi128_si32(Binomial5(taps[0], taps[1], taps[2], taps[3], taps[4]));
+            }
+        }
+    }
+}
+
+// Reads from `blurred` and writes back to `small`.
+void ThreadBloomBlurColumns(void* data) {
+    struct PostBandJob* job    = (struct PostBandJob*)data;
+    struct Bloom*       bloom  = (struct Bloom*)job->data;
+    i32                 width  = bloom->width;
+    i32                 height = bloom->height;
+
+    for (i32 y = job->first_row; y < job->last_row; y += 1) {
+        u32* rows[5];
+
+        for (i32 i = 0; i < 5; i += 1) {
+            rows[i] = bloom->blurred + Clamp(y + i - 2, 0, height - 1) * width;
+        }
+
+        u32* to = bloom->small + y * width;
+        i32  x  = 0;
+
+        for (; x + 4 <= width; x += 4) {
+            __m128i result = Binomial5(
+                LoadPixels(rows[0], x), LoadPixels(rows[1], x), LoadPixels(rows[2], x),
+                LoadPixels(rows[3], x), LoadPixels(rows[4], x)
+            );
+
+            _mm_storeu_si128((__m128i*)(to + x), result);
+        }
+
+        for (; x < width; x += 1) {
+            __m128i result = Binomial5(
+                _mm_cvtsi32_si128(rows[0][x]), _mm_cvtsi32_si128(rows[1][x]), _mm_cvtsi32_si128(rows[2][x]),
+                _mm_cvtsi32_si128(rows[3][x]), _mm_cvtsi32_si128(rows[4][x])
+            );
+
+            to[x] = _mm_cvtsi128_si32(result);
+        }
+    }
+}
+
+// Scales the blurred image back up bilinearly and adds it to the frame. Each
+// run of four output pixels sits between the same two bloom pixels, so the
+// blend weights are the same for every run.
+void ThreadBloomCombine(void* data) {
+    struct PostBandJob*     job    = (struct PostBandJob*)data;
+    struct Bloom*           bloom  = (struct Bloom*)job->data;
+    struct OffscreenBuffer* buffer = bloom->buffer;
+    i32                     width  = bloom->width;
+
+    __m128i zero     = _mm_setzero_si128();
+    __m128i strength = _mm_set1_epi16(bloom->post->bloom_strength);
+    __m128i t_lo     = _mm_set_epi16(1, 1, 1, 1, 0, 0, 0, 0);
+    __m128i t_hi     = _mm_set_epi16(3, 3, 3, 3, 2, 2, 2, 2);
+
+    for (i32 y = job->first_row; y < job->last_row; y += 1) {
+        i32 bloom_y = Min(y / 4, bloom->height - 1);
+        u32* top    = bloom->small + bloom_y * width;
+        u32* bottom = bloom->small + Min(bloom_y + 1, bloom->height - 1) * width;
+        __m128i t_y = _mm_set1_epi16(y - bloom_y * 4);
+
+        // Blend the two bloom rows for this output row, two pixels at a time.
+        u32* row = job->scratch;
+
+        for (i32 x = 0; x < width; x += 2) {
+            __m128i from = _mm_unpacklo_epi8(_mm_loadl_epi64((__m128i*)(top    + x)), zero);
+            __m128i to   = _mm_unpacklo_epi8(_mm_loadl_epi64((__m128i*)(bottom + x)), zero);
+            __m128i mix  = _mm_srli_epi16(_mm_mullo_epi16(LerpQuarters(from, to, t_y), strength), 8);
+
+            _mm_storel_epi64((__m128i*)(row + x), _mm_packus_epi16(mix, mix));
+        }
+
+        u32* pixels = (u32*)((u8*)buffer->pixels + y * buffer->pitch);
+
+        for (i32 x = 0; x < buffer->width; x += 4) {
+            i32 bloom_x = Min(x / 4, width - 1);
+
+            __m128i from = _mm_unpacklo_epi8(_mm_set1_epi32(row[bloom_x]), zero);
+            __m128i to   = _mm_unpacklo_epi8(_mm_set1_epi32(row[Min(bloom_x + 1, width - 1)]), zero);
+            __m128i glow = _mm_packus_epi16(LerpQuarters(from, to, t_lo), LerpQuarters(from, to, t_hi));
+
+            if (x + 4 <= buffer->width) {
+                __m128i* out = (__m128i*)(pixels + x);
+                _mm_storeu_si128(out, _mm_adds_epu8(_mm_loadu_si128(out), glow));
+            } else {
+                u32 lanes[4];
+                _mm_storeu_si128((__m128i*)lanes, glow);
+
+                for (i32 i = 0; x + i < buffer->width; i += 1) {
+                    __m128i out = _mm_adds_epu8(_mm_cvtsi32_si128(pixels[x + i]), _mm_cvtsi32_si128(lanes[i]));
+                    pixels[x + i] = _mm_cvtsi128_si32(out);
+                }
+            }
+        }
+    }
+}
+
+void RunBloom(struct PostProcess* post, struct OffscreenBuffer* buffer, struct JobQueue* queue, struct MemoryArena* arena) {
+    struct Bloom bloom = {
+        .post   = post,
+        .buffer = buffer,
+        .width  = buffer->width  / 4,
+        .height = buffer->height / 4,
+    };
+
+    if (bloom.width > 0 && bloom.height > 0) {
+        u8 threshold = post->bloom_threshold;
+
+        // The alpha is subtracted away completely so it doesn't get added back on.
+        bloom.threshold = ConvertColour(ARGB(0xFF, threshold, threshold, threshold), buffer->format);
+
+        // Padded so the two at a time loops can read past the end of a row.
+        bloom.small   = PushArray(arena, u32, bloom.width * bloom.height + 2);
+        bloom.blurred = PushArray(arena, u32, bloom.width * bloom.height + 2);
+
+        RunPostBands(queue, arena, bloom.height, 0, ThreadBloomDownsample, &bloom);
+
+        for (u32 i = 0; i < post->bloom_blur_passes; i += 1) {
+            RunPostBands(queue, arena, bloom.height, 0, ThreadBloomBlurRows,    &bloom);
+            RunPostBands(queue, arena, bloom.height, 0, ThreadBloomBlurColumns, &bloom);
+        }
+
+        RunPostBands(queue, arena, buffer->height, bloom.width + 2, ThreadBloomCombine, &bloom);
+    }
+}
+
+// ==============================================
+// Vignette
+
+struct Vignette {
+    struct OffscreenBuffer* buffer;
+           u16*             columns;
+           u16*             rows;
+};
+
+// Both weights are out of 65535 so their product fits back into 16 bits with
+// a high multiply. The result is turned into a 1 to 256 light for MultiplyLight4.
+void ThreadVignette(void* data) {
+    struct PostBandJob*     job      = (struct PostBandJob*)data;
+    struct Vignette*        vignette = (struct Vignette*)job->data;
+    struct OffscreenBuffer* buffer   = vignette->buffer;
+
+    __m128i one = _mm_set1_epi16(1);
+
+    for (i32 y = job->first_row; y < job->last_row; y += 1) {
+        __m128i row_weight = _mm_set1_epi16(vignette->rows[y]);
+        u32*    pixels     = (u32*)((u8*)buffer->pixels + y * buffer->pitch);
+        i32     x          = 0;
+
+        for (; x < buffer->width; x += 4) {
+            __m128i weights = _mm_loadl_epi64((__m128i*)(vignette->columns + x));
+
+            weights = _mm_add_epi16(_mm_srli_epi16(_mm_mulhi_epu16(weights, row_weight), 8), one);
+            weights = _mm_unpacklo_epi16(weights, weights);
+
+            __m128i light_lo = _mm_unpacklo_epi32(weights, weights);
+            __m128i light_hi = _mm_unpackhi_epi32(weights, weights);
+
+            if (x + 4 <= buffer->width) {
+                __m128i* out = (__m128i*)(pixels + x);
+                _mm_storeu_si128(out, MultiplyLight4(_mm_loadu_si128(out), light_lo, light_hi));
+            } else {
+                for (i32 i = 0; x + i < buffer->width; i += 1) {
+                    __m128i light = i < 2 ? light_lo : light_hi;
+
+                    if (i & 1) {
+                        light = _mm_unpackhi_epi64(light, light);
+                    }
+
+                    pixels[x + i] = _mm_cvtsi128_si32(MultiplyLight4(_mm_cvtsi32_si128(pixels[x + i]), light, light));
+                }
+            }
+        }
+    }
+}
+
+// Falls off with the square of the distance from the middle along each axis.
+// The product of the two is `corner` in the corners.
+void FillVignetteWeights(u16* weights, i32 count, u32 corner) {
+    f32 edge = sqrtf((f32)corner / 256.0f);
+
+    for (i32 i = 0; i < count; i += 1) {
+        f32 t = (2.0f * i + 1.0f) / (f32)count - 1.0f;
+        weights[i] = (u16)(65535.0f * (1.0f - (1.0f - edge) * t * t));
+    }
+}
+
+void RunVignette(struct PostProcess* post, struct OffscreenBuffer* buffer, struct JobQueue* queue, struct MemoryArena* arena) {
+    struct Vignette vignette = {
+        .buffer  = buffer,
+        .columns = PushArray(arena, u16, buffer->width + 4),
+        .rows    = PushArray(arena, u16, buffer->height),
+    };
+
+    FillVignetteWeights(vignette.columns, buffer->width,  post->vignette_corner);
+    FillVignetteWeights(vignette.rows,    buffer->height, post->vignette_corner);
+
+    RunPostBands(queue, arena, buffer->height, 0, ThreadVignette, &vignette);
+}
+
+// ==============================================
+// CRT
+
+// Every other row is dimmed for scanlines, and each column only lets one of
+// red, green or blue through at full strength like an aperture grille. The
+// pattern repeats every three columns, so a run of four pixels starts on each
+// phase in turn and there are only three sets of lights per kind of row.
+struct Crt {
+    struct OffscreenBuffer* buffer;
+           __m128i          lights[2][3][2];
+};
+
+void ThreadCrt(void* data) {
+    struct PostBandJob*     job    = (struct PostBandJob*)data;
+    struct Crt*             crt    = (struct Crt*)job->data;
+    struct OffscreenBuffer* buffer = crt->buffer;
+
+    for (i32 y = job->first_row; y < job->last_row; y += 1) {
+        u32* pixels = (u32*)((u8*)buffer->pixels + y * buffer->pitch);
+        u32  phase  = 0;
+        i32  x      = 0;
+
+        __m128i (*lights)[2] = crt->lights[y & 1];
+
+        for (; x + 4 <= buffer->width; x += 4) {
+            __m128i* out = (__m128i*)(pixels + x);
+            _mm_storeu_si128(out, MultiplyLight4(_mm_loadu_si128(out), lights[phase][0], lights[phase][1]));
+
+            phase = (phase + 1) % 3;
+        }
+
+        for (; x < buffer->width; x += 1) {
+            __m128i light = lights[x % 3][0];
+            pixels[x] = _mm_cvtsi128_si32(MultiplyLight4(_mm_cvtsi32_si128(pixels[x]), light, light));
+        }
+    }
+}
+
+void RunCrt(struct PostProcess* post, struct OffscreenBuffer* buffer, struct JobQueue* queue, struct MemoryArena* arena) {
+    struct Crt* crt = PushStruct(arena, struct Crt);
+    crt->buffer = buffer;
+
+    for (u32 odd = 0; odd < 2; odd += 1) {
+        u32 scanline = odd ? post->crt_scanline : 256;
+
+        for (u32 phase = 0; phase < 3; phase += 1) {
+            u16 lanes[16];
+
+            for (u32 pixel = 0; pixel < 4; pixel += 1) {
+                u32 lit     = (phase + pixel) % 3;
+                u32 channel = 2 - lit; // Red, green then blue, from the top of the ARGB channels down.
+
+                // Work out the light in ARGB, then move the channels to where the buffer keeps
+                // them. Each byte holds the light minus one so that 256 fits.
+                u32 argb = 0xFF000000;
+
+                for (u32 i = 0; i < 3; i += 1) {
+                    u32 amount = (i == channel) ? 256 : post->crt_mask;
+                    argb |= (Clamp(amount * scanline >> 8, 1, 256) - 1) << (i * 8);
+                }
+
+                u32 light = ConvertColour(argb, buffer->format);
+
+                for (u32 i = 0; i < 4; i += 1) {
+                    lanes[pixel * 4 + i] = ((light >> (i * 8)) & 0xFF) + 1;
+                }
+            }
+
+            crt->lights[odd][phase][0] = _mm_loadu_si128((__m128i*)(lanes + 0));
+            crt->lights[odd][phase][1] = _mm_loadu_si128((__m128i*)(lanes + 8));
+        }
+    }
+
+    RunPostBands(queue, arena, buffer->height, 0, ThreadCrt, crt);
+}
+
+// ==============================================
+// Running the chain
+
+void RunPostProcess(struct PostProcess* post, struct OffscreenBuffer* buffer, struct JobQueue* queue, struct MemoryArena* arena) {
+    post->total_milliseconds = 0.0f;
+
+    for (u32 i = 0; i < post->pass_count; i += 1) {
+        struct PostPass* pass = &post->passes[i];
+
+        pass->milliseconds = 0.0f;
+
+        bool over_budget = post->budget_milliseconds > 0.0f && post->total_milliseconds >= post->budget_milliseconds;
+
+        if (pass->enabled && !over_budget) {
+            u64 begin = GetWallClock();
+
+            switch (pass->type) {
+                case PostPassBloom:    RunBloom   (post, buffer, queue, arena); break;
+                case PostPassVignette: RunVignette(post, buffer, queue, arena); break;
+                case PostPassCrt:      RunCrt     (post, buffer, queue, arena); break;
+            }
+
+            pass->milliseconds        = GetSecondsElapsed(begin, GetWallClock()) * 1000.0f;
+            post->total_milliseconds += pass->milliseconds;
+        }
+    }
+}
@@ -0,0 +1,46 @@
+// ==============================================
+// Post Processing
+// ==============================================
+
+enum PostPassType {
+    PostPassBloom,
+    PostPassVignette,
+    PostPassCrt,
+};
+
+struct PostPass {
+    enum PostPassType type;
+         bool         enabled;
+
+    // How long the pass took last frame, zero when it didn't run.
+         f32          milliseconds;
+};
+
+#define MAX_POST_PASSES 8
+
+// Every band is pushed before any are waited on, and the job queue only holds
+// 256 entries.
+#define MAX_POST_BANDS 64
+
+// Full screen effects run over the finished frame in the order they were
+// added. Passes that would start after the budget has been spent are skipped
+// for the frame, so the chain can't cost much more than the budget.
+struct PostProcess {
+    struct PostPass passes[MAX_POST_PASSES];
+           u32      pass_count;
+           f32      budget_milliseconds;
+           f32      total_milliseconds;
+
+    // Bloom picks out anything brighter than the threshold at quarter resolution,
+    // blurs it and adds it back on top. Strength is out of 256.
+           u8       bloom_threshold;
+           u32      bloom_strength;
+           u32      bloom_blur_passes;
+
+    // Out of 256, how much is left at the corners.
+           u32      vignette_corner;
+
+    // Out of 256, how much of each scanline and each unlit phosphor is left.
+           u32      crt_scanline;
+           u32      crt_mask;
+};
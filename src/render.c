@@ -0,0 +1,1160 @@
+// ==============================================
+// Primitives
+// ==============================================
+
+bool IntersectRect(struct Rect a, struct Rect b, struct Rect* result) {
+    i32 min_x = Max(a.x, b.x);
+    i32 min_y = Max(a.y, b.y);
+    i32 max_x = Min(a.x + a.w, b.x + b.w);
+    i32 max_y = Min(a.y + a.h, b.y + b.h);
+
+    result->x = min_x;
+    result->y = min_y;
+    result->w = max_x - min_x;
+    result->h = max_y - min_y;
+
+    return(min_x < max_x && min_y < max_y);
+}
+
+void DrawRectIndexed(
+    struct IndexedBuffer* buffer,
+    struct Rect clip,
+    i32 x, i32 y, i32 w, i32 h,
+    u8 colour
+) {
+    struct Rect area;
+
+    if (IntersectRect(clip, (struct Rect){ x, y, w, h }, &area)) {
+        u8* row = buffer->pixels + area.x + area.y * buffer->pitch;
+
+        for (i32 y = 0; y < area.h; y += 1) {
+            memset(row, colour, area.w);
+            row += buffer->pitch;
+        }
+    }
+}
+
+// ==============================================
+// Kernels
+// ==============================================
+
+// Moves the channels of an ARGB colour to where the format keeps them. The
+// 4 wide versions do the same to each 32 bit lane.
+#define SwizzleARGB8888(c) (c)
+#define SwizzleABGR8888(c) (((c) & 0xFF00FF00) | (((c) >> 16) & 0xFF) | (((c) & 0xFF) << 16))
+#define SwizzleRGBA8888(c) (((c) << 8) | ((c) >> 24))
+#define SwizzleBGRA8888(c) (((c) << 24) | (((c) & 0xFF00) << 8) | (((c) >> 8) & 0xFF00) | ((c) >> 24))
+
+#define Swizzle4ARGB8888(v) (v)
+#define Swizzle4ABGR8888(v) _mm_or_si128(                                                         \
+    _mm_and_si128(v, _mm_set1_epi32(0xFF00FF00)),                                               \
+    _mm_or_si128(                                                                               \
+        _mm_and_si128(_mm_srli_epi32(v, 16), _mm_set1_epi32(0xFF)),                             \
+        _mm_slli_epi32(_mm_and_si128(v, _mm_set1_epi32(0xFF)), 16)                              \
+    )                                                                                           \
+)
+#define Swizzle4RGBA8888(v) _mm_or_si128(_mm_slli_epi32(v, 8), _mm_srli_epi32(v, 24))
+#define Swizzle4BGRA8888(v) ByteSwap4(_mm_shufflehi_epi16(_mm_shufflelo_epi16(v, 0xB1), 0xB1))
+
+// Which 16 bit lane of an unpacked pixel holds alpha, as a shuffle that copies
+// it across all four lanes.
+#define AlphaLanesARGB8888 0xFF
+#define AlphaLanesABGR8888 0xFF
+#define AlphaLanesRGBA8888 0x00
+#define AlphaLanesBGRA8888 0x00
+
+#define AlphaShiftARGB8888 24
+#define AlphaShiftABGR8888 24
+#define AlphaShiftRGBA8888 0
+#define AlphaShiftBGRA8888 0
+
+__m128i ByteSwap4(__m128i v) {
+    return(_mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8)));
+}
+
+// (source * alpha + dest * (256 - alpha)) / 256 on four pixels, with alpha
+// already spread over the 16 bit lanes of each pixel. 255 is bumped to 256 so
+// that opaque pixels replace the destination exactly.
+__m128i BlendAlpha4(__m128i dest, __m128i source, __m128i alpha_lo, __m128i alpha_hi) {
+    __m128i zero = _mm_setzero_si128();
+    __m128i full = _mm_set1_epi16(256);
+
+    alpha_lo = _mm_add_epi16(alpha_lo, _mm_srli_epi16(alpha_lo, 7));
+    alpha_hi = _mm_add_epi16(alpha_hi, _mm_srli_epi16(alpha_hi, 7));
+
+    __m128i lo = _mm_add_epi16(
+        _mm_mullo_epi16(_mm_unpacklo_epi8(source, zero), alpha_lo),
+        _mm_mullo_epi16(_mm_unpacklo_epi8(dest,   zero), _mm_sub_epi16(full, alpha_lo))
+    );
+    __m128i hi = _mm_add_epi16(
+        _mm_mullo_epi16(_mm_unpackhi_epi8(source, zero), alpha_hi),
+        _mm_mullo_epi16(_mm_unpackhi_epi8(dest,   zero), _mm_sub_epi16(full, alpha_hi))
+    );
+
+    return(_mm_packus_epi16(_mm_srli_epi16(lo, 8), _mm_srli_epi16(hi, 8)));
+}
+
+// Runs `body` over every pixel of the area, four at a time and then one at a
+// time for what is left of each row. `body` reads and assigns `pixels`, only
+// the low lane matters for the single pixels.
+#define FillRows(buffer, area, body) {                                                           \
+    u8* row = (u8*)(buffer)->pixels + (area).x * 4 + (area).y * (buffer)->pitch;                 \
+                                                                                                 \
+    for (i32 y = 0; y < (area).h; y += 1) {                                                      \
+        u32* to = (u32*)row;                                                                     \
+        i32  x  = 0;                                                                             \
+                                                                                                 \
+        for (; x + 4 <= (area).w; x += 4) {                                                      \
+            __m128i pixels = _mm_loadu_si128((__m128i*)(to + x));                                \
+            body                                                                                 \
+            _mm_storeu_si128((__m128i*)(to + x), pixels);                                        \
+        }                                                                                        \
+                                                                                                 \
+        for (; x < (area).w; x += 1) {                                                           \
+            __m128i pixels = _mm_cvtsi32_si128(to[x]);                                           \
+            body                                                                                 \
+            to[x] = _mm_cvtsi128_si32(pixels);                                                   \
+        }                                                                                        \
+                                                                                                 \
+        row += (buffer)->pitch;                                                                  \
+    }                                                                                            \
+}
+
+// The same, with the matching `source` pixels loaded alongside.
+#define BlitRows(buffer, area, source_row, source_pitch, body) {                                 \
+    u8* row      = (u8*)(buffer)->pixels + (area).x * 4 + (area).y * (buffer)->pitch;            \
+    u8* from_row = (u8*)(source_row);                                                            \
+                                                                                                 \
+    for (i32 y = 0; y < (area).h; y += 1) {                                                      \
+        u32* to   = (u32*)row;                                                                   \
+        u32* from = (u32*)from_row;                                                              \
+        i32  x    = 0;                                                                           \
+                                                                                                 \
+        for (; x + 4 <= (area).w; x += 4) {                                                      \
+            __m128i pixels = _mm_loadu_si128((__m128i*)(to   + x));                              \
+            __m128i source = _mm_loadu_si128((__m128i*)(from + x));                              \
+            body                                                                                 \
+            _mm_storeu_si128((__m128i*)(to + x), pixels);                                        \
+        }                                                                                        \
+                                                                                                 \
+        for (; x < (area).w; x += 1) {                                                           \
+            __m128i pixels = _mm_cvtsi32_si128(to[x]);                                           \
+            __m128i source = _mm_cvtsi32_si128(from[x]);                                         \
+            body                                                                                 \
+            to[x] = _mm_cvtsi128_si32(pixels);                                                   \
+        }                                                                                        \
+                                                                                                 \
+        row      += (buffer)->pitch;                                                             \
+        from_row += (source_pitch);                                                              \
+    }                                                                                            \
+}
+
+#define DefinePixelFormatKernels(format)                                                                       \
+    u32 ConvertColour##format(u32 colour) {                                                                    \
+        return(Swizzle##format(colour));                                                                       \
+    }                                                                                                          \
+                                                                                                               \
+    void Fill##format##Copy(struct OffscreenBuffer* buffer, struct Rect area, u32 colour) {                    \
+        __m128i fill = _mm_set1_epi32(colour);                                                                 \
+        FillRows(buffer, area, { pixels = fill; });                                                            \
+    }                                                                                                          \
+                                                                                                               \
+    void Fill##format##Alpha(struct OffscreenBuffer* buffer, struct Rect area, u32 colour) {                   \
+        __m128i fill  = _mm_set1_epi32(colour);                                                                \
+        __m128i alpha = _mm_set1_epi16((colour >> AlphaShift##format) & 0xFF);                                 \
+        FillRows(buffer, area, { pixels = BlendAlpha4(pixels, fill, alpha, alpha); });                         \
+    }                                                                                                          \
+                                                                                                               \
+    void Fill##format##Add(struct OffscreenBuffer* buffer, struct Rect area, u32 colour) {                     \
+        __m128i fill = _mm_set1_epi32(colour);                                                                 \
+        FillRows(buffer, area, { pixels = _mm_adds_epu8(pixels, fill); });                                     \
+    }                                                                                                          \
+                                                                                                               \
+    void Blit##format##Copy(struct OffscreenBuffer* buffer, struct Rect area, u32* source, i32 pitch) {        \
+        BlitRows(buffer, area, source, pitch, { pixels = Swizzle4##format(source); });                         \
+    }                                                                                                          \
+                                                                                                               \
+    void Blit##format##Alpha(struct OffscreenBuffer* buffer, struct Rect area, u32* source, i32 pitch) {       \
+        BlitRows(buffer, area, source, pitch, {                                                                \
+            __m128i zero     = _mm_setzero_si128();                                                            \
+            __m128i swizzled = Swizzle4##format(source);                                                       \
+            __m128i alpha_lo = _mm_unpacklo_epi8(swizzled, zero);                                              \
+            __m128i alpha_hi = _mm_unpackhi_epi8(swizzled, zero);                                              \
+                                                                                                               \
+            alpha_lo = _mm_shufflelo_epi16(alpha_lo, AlphaLanes##format);                                      \
+            alpha_lo = _mm_shufflehi_epi16(alpha_lo, AlphaLanes##format);                                      \
+            alpha_hi = _mm_shufflelo_epi16(alpha_hi, AlphaLanes##format);                                      \
+            alpha_hi = _mm_shufflehi_epi16(alpha_hi, AlphaLanes##format);                                      \
+                                                                                                               \
+            pixels = BlendAlpha4(pixels, swizzled, alpha_lo, alpha_hi);                                        \
+        });                                                                                                    \
+    }                                                                                                          \
+                                                                                                               \
+    void Blit##format##Add(struct OffscreenBuffer* buffer, struct Rect area, u32* source, i32 pitch) {         \
+        BlitRows(buffer, area, source, pitch, { pixels = _mm_adds_epu8(pixels, Swizzle4##format(source)); });  \
+    }
+
+DefinePixelFormatKernels(ARGB8888)
+DefinePixelFormatKernels(ABGR8888)
+DefinePixelFormatKernels(RGBA8888)
+DefinePixelFormatKernels(BGRA8888)
+
+#define PixelFormatKernels(kind, format) { \
+    [BlendCopy]  = kind##format##Copy,     \
+    [BlendAlpha] = kind##format##Alpha,    \
+    [BlendAdd]   = kind##format##Add,      \
+}
+
+static FillKernel fill_kernels[PixelFormatCount][BlendModeCount] = {
+    [PixelFormatARGB8888] = PixelFormatKernels(Fill, ARGB8888),
+    [PixelFormatABGR8888] = PixelFormatKernels(Fill, ABGR8888),
+    [PixelFormatRGBA8888] = PixelFormatKernels(Fill, RGBA8888),
+    [PixelFormatBGRA8888] = PixelFormatKernels(Fill, BGRA8888),
+};
+
+static BlitKernel blit_kernels[PixelFormatCount][BlendModeCount] = {
+    [PixelFormatARGB8888] = PixelFormatKernels(Blit, ARGB8888),
+    [PixelFormatABGR8888] = PixelFormatKernels(Blit, ABGR8888),
+    [PixelFormatRGBA8888] = PixelFormatKernels(Blit, RGBA8888),
+    [PixelFormatBGRA8888] = PixelFormatKernels(Blit, BGRA8888),
+};
+
+static u32 alpha_shifts[PixelFormatCount] = {
+    [PixelFormatARGB8888] = AlphaShiftARGB8888,
+    [PixelFormatABGR8888] = AlphaShiftABGR8888,
+    [PixelFormatRGBA8888] = AlphaShiftRGBA8888,
+    [PixelFormatBGRA8888] = AlphaShiftBGRA8888,
+};
+
+static ColourConverter colour_converters[PixelFormatCount] = {
+    [PixelFormatARGB8888] = ConvertColourARGB8888,
+    [PixelFormatABGR8888] = ConvertColourABGR8888,
+    [PixelFormatRGBA8888] = ConvertColourRGBA8888,
+    [PixelFormatBGRA8888] = ConvertColourBGRA8888,
+};
+
+// Converts an ARGB colour into the layout of the given format.
+u32 ConvertColour(u32 colour, enum PixelFormat format) {
+    return(colour_converters[format](colour));
+}
+
+// Fills the clipped rect, `colour` is in the buffer's format.
+void FillRect(
+    struct OffscreenBuffer* buffer,
+    struct Rect clip,
+    i32 x, i32 y, i32 w, i32 h,
+    u32 colour,
+    enum BlendMode blend
+) {
+    struct Rect area;
+
+    if (IntersectRect(clip, (struct Rect){ x, y, w, h }, &area)) {
+        fill_kernels[buffer->format][blend](buffer, area, colour);
+    }
+}
+
+// Draws an ARGB image with its top left corner at (x, y), clipped.
+void BlitRect(
+    struct OffscreenBuffer* buffer,
+    struct Rect clip,
+    i32 x, i32 y,
+    u32* source, i32 source_width, i32 source_height, i32 source_pitch,
+    enum BlendMode blend
+) {
+    struct Rect area;
+
+    if (IntersectRect(clip, (struct Rect){ x, y, source_width, source_height }, &area)) {
+        u32* first = (u32*)((u8*)source + (area.y - y) * source_pitch) + (area.x - x);
+        blit_kernels[buffer->format][blend](buffer, area, first, source_pitch);
+    }
+}
+
+void DrawRect(
+    struct OffscreenBuffer* buffer,
+    struct Rect clip,
+    i32 x, i32 y, i32 w, i32 h,
+    u32 colour
+) {
+    FillRect(buffer, clip, x, y, w, h, colour, BlendCopy);
+}
+
+// ==============================================
+// Palettes
+// ==============================================
+
+// Converts the clipped part of an indexed buffer into the matching part of the
+// output. SSE2 has no gather, so the lookups are scalar, but the palette is only
+// a kilobyte and stays in L1, and the output is written 16 bytes at a time.
+void ExpandIndexed(
+    struct IndexedBuffer*   source,
+    struct OffscreenBuffer* dest,
+    struct Rect             clip,
+    struct Palette*         palette
+) {
+    u32* colours = palette->colours;
+
+    for (i32 y = clip.y; y < clip.y + clip.h; y += 1) {
+        u8*  from = source->pixels + clip.x + y * source->pitch;
+        u32* to   = (u32*)((u8*)dest->pixels + y * dest->pitch) + clip.x;
+        i32  x    = 0;
+
+        for (; x + 16 <= clip.w; x += 16) {
+            __m128i a = _mm_setr_epi32(colours[from[x +  0]], colours[from[x +  1]], colours[from[x +  2]], colours[from[x +  3]]);
+            __m128i b = _mm_setr_epi32(colours[from[x +  4]], colours[from[x +  5]], colours[from[x +  6]], colours[from[x +  7]]);
+            __m128i c = _mm_setr_epi32(colours[from[x +  8]], colours[from[x +  9]], colours[from[x + 10]], colours[from[x + 11]]);
+            __m128i d = _mm_setr_epi32(colours[from[x + 12]], colours[from[x + 13]], colours[from[x + 14]], colours[from[x + 15]]);
+
+            _mm_storeu_si128((__m128i*)(to + x +  0), a);
+            _mm_storeu_si128((__m128i*)(to + x +  4), b);
+            _mm_storeu_si128((__m128i*)(to + x +  8), c);
+            _mm_storeu_si128((__m128i*)(to + x + 12), d);
+        }
+
+        for (; x < clip.w; x += 1) {
+            to[x] = colours[from[x]];
+        }
+    }
+}
+
+void CopyPalette(struct Palette* palette, u32* colours, u32 count) {
+    memset(palette->colours, 0, sizeof(palette->colours));
+    memcpy(palette->colours, colours, count * sizeof(u32));
+}
+
+// Moves every colour towards `colour` by `amount` out of 255, for flashes and fades.
+void BlendPalette(struct Palette* palette, u32 colour, u32 amount) {
+    for (u32 i = 0; i < ArrayCount(palette->colours); i += 1) {
+        u32 result = 0xFF000000;
+
+        for (u32 shift = 0; shift < 24; shift += 8) {
+            u32 from = (palette->colours[i] >> shift) & 0xFF;
+            u32 to   = (colour              >> shift) & 0xFF;
+
+            result |= ((from * (255 - amount) + to * amount) / 255) << shift;
+        }
+
+        palette->colours[i] = result;
+    }
+}
+
+// Multiplies every colour by `tint`, where 255 leaves a channel alone.
+void TintPalette(struct Palette* palette, u32 tint) {
+    for (u32 i = 0; i < ArrayCount(palette->colours); i += 1) {
+        palette->colours[i] = MultiplyLight(palette->colours[i], tint | 0xFF000000);
+    }
+}
+
+// ==============================================
+// Sorting
+// ==============================================
+
+// Below this many entries per job the cost of going wide outweighs the work.
+#define RADIX_MIN_ENTRIES_PER_JOB 4096
+#define RADIX_PASS_COUNT          8
+
+struct RadixSortJob {
+    struct SortEntry* source;
+    struct SortEntry* dest;
+    u32               begin;
+    u32               end;
+    u32               shift;
+
+    // The histogram of each digit in this job's range. For the pass being
+    // scattered it is turned into the write offsets of each bucket.
+    u32 counts[RADIX_PASS_COUNT][256];
+};
+
+void ThreadRadixHistogramAll(void* data) {
+    struct RadixSortJob* job = (struct RadixSortJob*)data;
+
+    memset(job->counts, 0, sizeof(job->counts));
+
+    for (u32 i = job->begin; i < job->end; i += 1) {
+        u64 key = job->source[i].key;
+
+        for (u32 pass = 0; pass < RADIX_PASS_COUNT; pass += 1) {
+            job->counts[pass][(key >> (pass * 8)) & 0xFF] += 1;
+        }
+    }
+}
+
+void ThreadRadixHistogram(void* data) {
+    struct RadixSortJob* job    = (struct RadixSortJob*)data;
+    u32*                 counts = job->counts[job->shift / 8];
+
+    memset(counts, 0, sizeof(job->counts[0]));
+
+    for (u32 i = job->begin; i < job->end; i += 1) {
+        counts[(job->source[i].key >> job->shift) & 0xFF] += 1;
+    }
+}
+
+void ThreadRadixScatter(void* data) {
+    struct RadixSortJob* job     = (struct RadixSortJob*)data;
+    u32*                 offsets = job->counts[job->shift / 8];
+
+    for (u32 i = job->begin; i < job->end; i += 1) {
+        struct SortEntry entry = job->source[i];
+        job->dest[offsets[(entry.key >> job->shift) & 0xFF]++] = entry;
+    }
+}
+
+// Stable least significant digit radix sort, 8 bits at a time. Each job owns a
+// contiguous range of the input and the buckets are laid out digit-major then
+// job-minor, so equal keys never change their relative order.
+// Returns whichever of `entries` or `scratch` ends up holding the sorted data.
+struct SortEntry* RadixSort(
+    struct SortEntry*   entries,
+    struct SortEntry*   scratch,
+    u32                 count,
+    struct JobQueue*    queue,
+    struct MemoryArena* arena
+) {
+    u32 job_count = Clamp(count / RADIX_MIN_ENTRIES_PER_JOB, 1, CpuCoreCount(queue));
+    struct RadixSortJob* jobs = PushArray(arena, struct RadixSortJob, job_count);
+
+    u32 per_job = count / job_count;
+
+    for (u32 i = 0; i < job_count; i += 1) {
+        struct RadixSortJob* job = &jobs[i];
+
+        job->source = entries;
+        job->dest   = scratch;
+        job->begin  = i * per_job;
+        job->end    = (i == job_count - 1) ? count : job->begin + per_job;
+        job->shift  = 0;
+
+        PushJob(queue, job, ThreadRadixHistogramAll);
+    }
+
+    CompleteRemainingWork(queue);
+
+    // The jobs still own their original ranges, so the histograms of whichever
+    // pass runs first can be used as they are.
+    bool histograms_valid = true;
+
+    for (u32 pass = 0; pass < RADIX_PASS_COUNT; pass += 1) {
+        u32 shift = pass * 8;
+
+        // If every key has the same digit this pass would be a copy, so skip it.
+        // Sort keys leave a lot of bits empty, this usually saves half the passes.
+        bool is_trivial = false;
+
+        for (u32 digit = 0; digit < 256 && !is_trivial; digit += 1) {
+            u32 total = 0;
+
+            for (u32 i = 0; i < job_count; i += 1) {
+                total += jobs[i].counts[pass][digit];
+            }
+
+            is_trivial = total == count;
+        }
+
+        if (is_trivial) continue;
+
+        if (!histograms_valid) {
+            for (u32 i = 0; i < job_count; i += 1) {
+                jobs[i].shift = shift;
+                PushJob(queue, &jobs[i], ThreadRadixHistogram);
+            }
+
+            CompleteRemainingWork(queue);
+        }
+
+        u32 offset = 0;
+
+        for (u32 digit = 0; digit < 256; digit += 1) {
+            for (u32 i = 0; i < job_count; i += 1) {
+                u32 digit_count = jobs[i].counts[pass][digit];
+                jobs[i].counts[pass][digit] = offset;
+                offset += digit_count;
+            }
+        }
+
+        for (u32 i = 0; i < job_count; i += 1) {
+            jobs[i].shift = shift;
+            PushJob(queue, &jobs[i], ThreadRadixScatter);
+        }
+
+        CompleteRemainingWork(queue);
+
+        struct SortEntry* swap = entries;
+        entries = scratch;
+        scratch = swap;
+
+        for (u32 i = 0; i < job_count; i += 1) {
+            jobs[i].source = entries;
+            jobs[i].dest   = scratch;
+        }
+
+        histograms_valid = false;
+    }
+
+    return(entries);
+}
+
+// ==============================================
+// Render Groups
+// ==============================================
+
+struct RenderGroup* AllocateRenderGroup(struct MemoryArena* arena, u32 capacity) {
+    struct RenderGroup* group = PushStruct(arena, struct RenderGroup);
+
+    group->arena        = arena;
+    group->sprites      = PushArray(arena, struct Sprite,    capacity);
+    group->entries      = PushArray(arena, struct SortEntry, capacity);
+    group->count        = 0;
+    group->capacity     = capacity;
+    group->clear_colour = ColourBlack;
+    group->palette      = NULL;
+    group->lighting     = NULL;
+    group->indexed      = NULL;
+    group->particles    = NULL;
+    group->static_layer = NULL;
+    group->layouts      = NULL;
+
+    return(group);
+}
+
+// Reserves the next sprite and its sort entry, NULL once the group is full.
+struct Sprite* PushSprite(struct RenderGroup* group, u64 sort_key, enum SpriteKind kind, u8 colour) {
+    Assert(group->count < group->capacity);
+
+    struct Sprite* sprite = NULL;
+
+    if (group->count < group->capacity) {
+        u32 index = group->count++;
+
+        sprite         = &group->sprites[index];
+        sprite->kind   = kind;
+        sprite->flags  = 0;
+        sprite->colour = colour;
+
+        struct SortEntry* entry = &group->entries[index];
+        entry->key   = sort_key;
+        entry->index = index;
+    }
+
+    return(sprite);
+}
+
+void PushRect(
+    struct RenderGroup* group,
+    u64 sort_key,
+    i32 x, i32 y, i32 w, i32 h,
+    u8 colour
+) {
+    struct Sprite* sprite = PushSprite(group, sort_key, SpriteRect, colour);
+
+    if (sprite) {
+        sprite->x = x;
+        sprite->y = y;
+        sprite->w = w;
+        sprite->h = h;
+    }
+}
+
+// A one pixel wide line including both end points.
+void PushLine(
+    struct RenderGroup* group,
+    u64 sort_key,
+    i32 x0, i32 y0, i32 x1, i32 y1,
+    u8 colour,
+    bool anti_aliased
+) {
+    struct Sprite* sprite = PushSprite(group, sort_key, SpriteLine, colour);
+
+    if (sprite) {
+        // Anti-aliased lines touch one pixel either side of the ideal line.
+        i32 pad = anti_aliased ? 1 : 0;
+
+        sprite->x     = Min(x0, x1) - pad;
+        sprite->y     = Min(y0, y1) - pad;
+        sprite->w     = Abs(x1 - x0) + 1 + pad * 2;
+        sprite->h     = Abs(y1 - y0) + 1 + pad * 2;
+        sprite->flags = anti_aliased ? SpriteAntiAliased : 0;
+
+        sprite->shape.line.x0 = x0;
+        sprite->shape.line.y0 = y0;
+        sprite->shape.line.x1 = x1;
+        sprite->shape.line.y1 = y1;
+    }
+}
+
+// Covers the pixels whose distance from the centre is at most the radius. The
+// outline is the ring of those that are more than radius - 1 away.
+void PushCircle(
+    struct RenderGroup* group,
+    u64 sort_key,
+    i32 x, i32 y, i32 radius,
+    u8 colour,
+    bool filled
+) {
+    struct Sprite* sprite = PushSprite(group, sort_key, SpriteCircle, colour);
+
+    if (sprite) {
+        sprite->x     = x - radius;
+        sprite->y     = y - radius;
+        sprite->w     = radius * 2 + 1;
+        sprite->h     = radius * 2 + 1;
+        sprite->flags = filled ? SpriteFilled : 0;
+
+        sprite->shape.circle.x      = x;
+        sprite->shape.circle.y      = y;
+        sprite->shape.circle.radius = radius;
+    }
+}
+
+// A filled convex polygon, pixels are covered when their centre is inside it.
+// The vertices are copied so the caller's can be temporary.
+void PushPolygon(
+    struct RenderGroup* group,
+    u64 sort_key,
+    struct Vertex* vertices, u32 count,
+    u8 colour
+) {
+    Assert(count >= 3);
+
+    struct Sprite* sprite = PushSprite(group, sort_key, SpritePolygon, colour);
+
+    if (sprite) {
+        f32 min_x = vertices[0].x;
+        f32 min_y = vertices[0].y;
+        f32 max_x = vertices[0].x;
+        f32 max_y = vertices[0].y;
+
+        for (u32 i = 1; i < count; i += 1) {
+            min_x = Min(min_x, vertices[i].x);
+            min_y = Min(min_y, vertices[i].y);
+            max_x = Max(max_x, vertices[i].x);
+            max_y = Max(max_y, vertices[i].y);
+        }
+
+        sprite->x = (i32)floorf(min_x);
+        sprite->y = (i32)floorf(min_y);
+        sprite->w = (i32)ceilf(max_x) - sprite->x;
+        sprite->h = (i32)ceilf(max_y) - sprite->y;
+
+        sprite->shape.polygon.vertices = PushArray(group->arena, struct Vertex, count);
+        sprite->shape.polygon.count    = count;
+
+        memcpy(sprite->shape.polygon.vertices, vertices, count * sizeof(struct Vertex));
+    }
+}
+
+void InitSpriteAtlas(struct SpriteAtlas* atlas, i32 width, i32 height, struct MemoryArena* arena) {
+    atlas->width   = width;
+    atlas->height  = height;
+    atlas->pitch   = (width + 15) & ~15;
+    atlas->pixels  = PushArray(arena, u8, atlas->pitch * height);
+    atlas->version = 1;
+
+    memset(atlas->pixels, ATLAS_TRANSPARENT, atlas->pitch * height);
+
+    atlas->texture.width         = width * 2;
+    atlas->texture.height        = height;
+    atlas->texture.pixels        = PushArray(arena, u32, atlas->texture.width * height);
+    atlas->texture.version       = 0;
+    atlas->texture_atlas_version = 0;
+}
+
+// Draws a w by h block of the atlas from (source_x, source_y) with its top left
+// at (x, y).
+void PushImage(
+    struct RenderGroup* group,
+    u64 sort_key,
+    i32 x, i32 y, i32 w, i32 h,
+    struct SpriteAtlas* atlas, i32 source_x, i32 source_y,
+    u8 colour
+) {
+    struct Sprite* sprite = PushSprite(group, sort_key, SpriteImage, colour);
+
+    if (sprite) {
+        sprite->x = x;
+        sprite->y = y;
+        sprite->w = w;
+        sprite->h = h;
+
+        sprite->shape.image.atlas = atlas;
+        sprite->shape.image.x     = source_x;
+        sprite->shape.image.y     = source_y;
+    }
+}
+
+// ==============================================
+// Shapes
+// ==============================================
+
+// Where a sprite is being drawn. The lit layers go into the indexed buffer when
+// there is one, everything else goes straight to the output.
+struct DrawTarget {
+    struct OffscreenBuffer* buffer;
+    struct IndexedBuffer*   indexed;
+    struct Palette*         palette;
+    struct Rect             clip;
+           u32              colour; // In the buffer's format.
+           u8               index;
+};
+
+// Fills [x_min, x_max] on row y, which must already be inside the clip.
+void FillSpan(struct DrawTarget* target, i32 y, i32 x_min, i32 x_max) {
+    x_min = Max(x_min, target->clip.x);
+    x_max = Min(x_max, target->clip.x + target->clip.w - 1);
+
+    if (x_min <= x_max) {
+        if (target->indexed) {
+            memset(target->indexed->pixels + x_min + y * target->indexed->pitch, target->index, x_max - x_min + 1);
+        } else {
+            struct Rect span = { x_min, y, x_max - x_min + 1, 1 };
+            fill_kernels[target->buffer->format][BlendCopy](target->buffer, span, target->colour);
+        }
+    }
+}
+
+// Coverage is out of 255. There is nothing to blend with in the indexed buffer,
+// so there a pixel is either on or off.
+void PlotPixel(struct DrawTarget* target, i32 x, i32 y, u32 coverage) {
+    struct Rect pixel = { x, y, 1, 1 };
+    struct Rect area;
+
+    if (coverage > 0 && IntersectRect(target->clip, pixel, &area)) {
+        if (target->indexed) {
+            if (coverage >= 128) {
+                target->indexed->pixels[x + y * target->indexed->pitch] = target->index;
+            }
+        } else if (coverage >= 255) {
+            ((u32*)((u8*)target->buffer->pixels + y * target->buffer->pitch))[x] = target->colour;
+        } else {
+            u32 shift  = alpha_shifts[target->buffer->format];
+            u32 colour = (target->colour & ~(0xFFu << shift)) | (coverage << shift);
+
+            fill_kernels[target->buffer->format][BlendAlpha](target->buffer, pixel, colour);
+        }
+    }
+}
+
+// Rather than stepping from the first end point, every pixel is worked out from
+// its position along the major axis, so a tile can start wherever the line
+// enters it. The pixels are the ones a midpoint line would pick. Anti-aliased
+// lines split each step between the two nearest pixels on the minor axis.
+void DrawLine(struct DrawTarget* target, struct Sprite* sprite) {
+    i32 x0 = sprite->shape.line.x0;
+    i32 y0 = sprite->shape.line.y0;
+    i32 x1 = sprite->shape.line.x1;
+    i32 y1 = sprite->shape.line.y1;
+
+    bool steep = Abs(y1 - y0) > Abs(x1 - x0);
+
+    // Work in (major, minor) so both cases share the code.
+    i32 a0 = steep ? y0 : x0;
+    i32 b0 = steep ? x0 : y0;
+    i32 a1 = steep ? y1 : x1;
+    i32 b1 = steep ? x1 : y1;
+
+    if (a0 > a1) {
+        i32 swap;
+        swap = a0; a0 = a1; a1 = swap;
+        swap = b0; b0 = b1; b1 = swap;
+    }
+
+    i32 clip_min = steep ? target->clip.y : target->clip.x;
+    i32 clip_max = steep ? target->clip.y + target->clip.h - 1 : target->clip.x + target->clip.w - 1;
+    i32 first    = Max(a0, clip_min);
+    i32 last     = Min(a1, clip_max);
+    i32 da       = a1 - a0;
+    i32 db       = b1 - b0;
+
+    for (i32 a = first; a <= last; a += 1) {
+        if (sprite->flags & SpriteAntiAliased && !target->indexed) {
+            f32 b        = da > 0 ? b0 + (f32)((a - a0) * db) / (f32)da : (f32)b0;
+            i32 b_floor  = (i32)floorf(b);
+            u32 coverage = (u32)((b - b_floor) * 255.0f);
+
+            PlotPixel(target, steep ? b_floor     : a, steep ? a : b_floor,     255 - coverage);
+            PlotPixel(target, steep ? b_floor + 1 : a, steep ? a : b_floor + 1, coverage);
+        } else {
+            i32 b = da > 0 ? b0 + FloorDiv(2 * (a - a0) * db + da, 2 * da) : b0;
+
+            PlotPixel(target, steep ? b : a, steep ? a : b, 255);
+        }
+    }
+}
+
+void DrawCircle(struct DrawTarget* target, struct Sprite* sprite) {
+    i32 centre_x = sprite->shape.circle.x;
+    i32 centre_y = sprite->shape.circle.y;
+    i32 radius   = sprite->shape.circle.radius;
+    i32 inner    = radius - 1;
+
+    i32 first = Max(centre_y - radius, target->clip.y);
+    i32 last  = Min(centre_y + radius, target->clip.y + target->clip.h - 1);
+
+    for (i32 y = first; y <= last; y += 1) {
+        i32 dy   = y - centre_y;
+        i32 half = (i32)sqrtf((f32)(radius * radius - dy * dy));
+
+        if ((sprite->flags & SpriteFilled) || dy * dy > inner * inner) {
+            FillSpan(target, y, centre_x - half, centre_x + half);
+        } else {
+            i32 inner_half = (i32)sqrtf((f32)(inner * inner - dy * dy));
+
+            FillSpan(target, y, centre_x - half,           centre_x - inner_half - 1);
+            FillSpan(target, y, centre_x + inner_half + 1, centre_x + half);
+        }
+    }
+}
+
+// Each row is sampled through the pixel centres. The polygon is convex, so the
+// edges it crosses give a single span.
+void DrawPolygon(struct DrawTarget* target, struct Sprite* sprite) {
+    struct Vertex* vertices = sprite->shape.polygon.vertices;
+    u32            count    = sprite->shape.polygon.count;
+
+    i32 first = Max(sprite->y, target->clip.y);
+    i32 last  = Min(sprite->y + sprite->h - 1, target->clip.y + target->clip.h - 1);
+
+    for (i32 y = first; y <= last; y += 1) {
+        f32 sample_y = y + 0.5f;
+        f32 left     =  1e30f;
+        f32 right    = -1e30f;
+
+        for (u32 i = 0; i < count; i += 1) {
+            struct Vertex a = vertices[i];
+            struct Vertex b = vertices[(i + 1) % count];
+
+            if ((a.y <= sample_y && b.y > sample_y) || (b.y <= sample_y && a.y > sample_y)) {
+                f32 x = a.x + (sample_y - a.y) * (b.x - a.x) / (b.y - a.y);
+
+                left  = Min(left,  x);
+                right = Max(right, x);
+            }
+        }
+
+        if (left < right) {
+            FillSpan(target, y, (i32)ceilf(left - 0.5f), (i32)ceilf(right - 0.5f) - 1);
+        }
+    }
+}
+
+// Into the indexed buffer sixteen pixels at a time, the transparent and body
+// pixels are picked out with compares so there are no branches per pixel.
+void DrawImage(struct DrawTarget* target, struct Sprite* sprite) {
+    struct SpriteAtlas* atlas = sprite->shape.image.atlas;
+    struct Rect         area;
+
+    if (IntersectRect(target->clip, (struct Rect){ sprite->x, sprite->y, sprite->w, sprite->h }, &area)) {
+        u8* source_row = atlas->pixels
+                       + (sprite->shape.image.x + area.x - sprite->x)
+                       + (sprite->shape.image.y + area.y - sprite->y) * atlas->pitch;
+
+        __m128i transparent = _mm_set1_epi8((char)ATLAS_TRANSPARENT);
+        __m128i body        = _mm_set1_epi8((char)ATLAS_BODY);
+        __m128i colour      = _mm_set1_epi8((char)target->index);
+
+        for (i32 y = area.y; y < area.y + area.h; y += 1) {
+            i32 x = 0;
+
+            if (target->indexed) {
+                u8* dest_row = target->indexed->pixels + area.x + y * target->indexed->pitch;
+
+                for (; x + 16 <= area.w; x += 16) {
+                    __m128i source = _mm_loadu_si128((__m128i*)(source_row + x));
+                    __m128i dest   = _mm_loadu_si128((__m128i*)(dest_row   + x));
+
+                    __m128i is_body        = _mm_cmpeq_epi8(source, body);
+                    __m128i is_transparent = _mm_cmpeq_epi8(source, transparent);
+
+                    source = _mm_or_si128(_mm_andnot_si128(is_body, source), _mm_and_si128(is_body, colour));
+                    dest   = _mm_or_si128(_mm_and_si128(is_transparent, dest), _mm_andnot_si128(is_transparent, source));
+
+                    _mm_storeu_si128((__m128i*)(dest_row + x), dest);
+                }
+
+                for (; x < area.w; x += 1) {
+                    u8 index = source_row[x];
+
+                    if (index != ATLAS_TRANSPARENT) {
+                        dest_row[x] = (index == ATLAS_BODY) ? target->index : index;
+                    }
+                }
+            } else {
+                u32* dest_row = (u32*)((u8*)target->buffer->pixels + y * target->buffer->pitch) + area.x;
+                u32* colours  = target->palette->colours;
+
+                for (; x < area.w; x += 1) {
+                    u8 index = source_row[x];
+
+                    if (index != ATLAS_TRANSPARENT) {
+                        dest_row[x] = (index == ATLAS_BODY) ? target->colour : colours[index];
+                    }
+                }
+            }
+
+            source_row += atlas->pitch;
+        }
+    }
+}
+
+// Draws the part of the sprite inside the clip, into the indexed buffer when one
+// is given and the output otherwise.
+void DrawSprite(
+    struct RenderGroup*     group,
+    struct OffscreenBuffer* buffer,
+    struct IndexedBuffer*   indexed,
+    struct Rect             clip,
+    struct Sprite*          sprite
+) {
+    struct DrawTarget target = {
+        .buffer  = buffer,
+        .indexed = indexed,
+        .palette = group->palette,
+        .clip    = clip,
+        .colour  = group->palette->colours[sprite->colour],
+        .index   = sprite->colour,
+    };
+
+    switch (sprite->kind) {
+        case SpriteRect: {
+            if (indexed) {
+                DrawRectIndexed(indexed, clip, sprite->x, sprite->y, sprite->w, sprite->h, sprite->colour);
+            } else {
+                DrawRect(buffer, clip, sprite->x, sprite->y, sprite->w, sprite->h, target.colour);
+            }
+        } break;
+
+        case SpriteLine:    DrawLine   (&target, sprite); break;
+        case SpriteCircle:  DrawCircle (&target, sprite); break;
+        case SpritePolygon: DrawPolygon(&target, sprite); break;
+        case SpriteImage:   DrawImage  (&target, sprite); break;
+    }
+}
+
+struct RenderTileJob {
+    struct OffscreenBuffer* buffer;
+    struct RenderGroup*     group;
+    struct RenderTile*      tile;
+};
+
+void ThreadRenderTile(void* data) {
+    struct RenderTileJob* job     = (struct RenderTileJob*)data;
+    struct RenderGroup*   group   = job->group;
+    struct RenderTile*    tile    = job->tile;
+    struct Rect           clip    = tile->clip;
+    u32*                  colours = group->palette->colours;
+
+    u32 i = 0;
+
+    if (group->static_layer) {
+        DrawStaticLayer(group, job->buffer, clip);
+    } else if (group->indexed) {
+        DrawRectIndexed(group->indexed, clip, clip.x, clip.y, clip.w, clip.h, group->clear_colour);
+    } else {
+        DrawRect(job->buffer, clip, clip.x, clip.y, clip.w, clip.h, colours[group->clear_colour]);
+    }
+
+    for (; i < tile->lit_count; i += 1) {
+        DrawSprite(group, job->buffer, group->indexed, clip, &group->sprites[tile->bin[i]]);
+    }
+
+    if (group->indexed) {
+        ExpandIndexed(group->indexed, job->buffer, clip, group->palette);
+    }
+
+    if (group->lighting) {
+        ApplyLighting(job->buffer, clip, group->lighting);
+    }
+
+    // Particles glow, so they go on top of the lighting with the rest of the effects.
+    DrawParticleFragments(job->buffer, clip, tile->fragments, tile->fragment_count);
+
+    for (; i < tile->bin_count; i += 1) {
+        DrawSprite(group, job->buffer, NULL, clip, &group->sprites[tile->bin[i]]);
+    }
+}
+
+struct TileLayout ComputeTileLayout(i32 width, i32 height, u32 cpu_core_count) {
+    struct TileLayout layout = {};
+
+    u32 chunks_per_side = Clamp(cpu_core_count / 2, 1, MAX_TILES_PER_SIDE);
+
+    layout.width       = width;
+    layout.height      = height;
+    layout.tile_width  = Max(width  / chunks_per_side, 1);
+    layout.tile_height = Max(height / chunks_per_side, 1);
+
+    // A buffer narrower than the chunk count would otherwise get a tile per
+    // pixel. The last row and column take whatever is left over.
+    layout.tiles_wide  = Min(width  / layout.tile_width,  (i32)chunks_per_side);
+    layout.tiles_high  = Min(height / layout.tile_height, (i32)chunks_per_side);
+
+    return(layout);
+}
+
+void ComputeTileClips(struct TileLayout* layout, struct Rect* clips) {
+    for (i32 y = 0; y < layout->tiles_high; y += 1) {
+        for (i32 x = 0; x < layout->tiles_wide; x += 1) {
+            struct Rect* clip = &clips[x + y * layout->tiles_wide];
+
+            bool last_row = y == layout->tiles_high - 1;
+            bool last_col = x == layout->tiles_wide - 1;
+
+            clip->x = x * layout->tile_width;
+            clip->y = y * layout->tile_height;
+            clip->w = last_col ? layout->width  - clip->x : layout->tile_width;
+            clip->h = last_row ? layout->height - clip->y : layout->tile_height;
+        }
+    }
+}
+
+struct CachedTileLayout* FindTileLayout(struct TileLayoutCache* cache, i32 width, i32 height, u32 cpu_core_count) {
+    for (u32 i = 0; i < cache->count; i += 1) {
+        struct CachedTileLayout* entry = &cache->entries[i];
+
+        if (entry->layout.width    == width  &&
+            entry->layout.height   == height &&
+            entry->cpu_core_count  == cpu_core_count) {
+            return(entry);
+        }
+    }
+
+    struct CachedTileLayout* entry = &cache->entries[cache->next];
+
+    cache->next  = (cache->next + 1) % TILE_LAYOUT_CACHE_SIZE;
+    cache->count = Min(cache->count + 1, TILE_LAYOUT_CACHE_SIZE);
+
+    entry->cpu_core_count = cpu_core_count;
+    entry->layout         = ComputeTileLayout(width, height, cpu_core_count);
+    ComputeTileClips(&entry->layout, entry->clips);
+
+    return(entry);
+}
+
+// The last row and column of tiles absorb any leftover pixels, so positions
+// past them are clamped back onto the edge tiles.
+void TileRange(struct TileLayout* layout, struct Rect area, i32* min_x, i32* min_y, i32* max_x, i32* max_y) {
+    *min_x = Clamp( area.x               / layout->tile_width,  0, layout->tiles_wide - 1);
+    *min_y = Clamp( area.y               / layout->tile_height, 0, layout->tiles_high - 1);
+    *max_x = Clamp((area.x + area.w - 1) / layout->tile_width,  0, layout->tiles_wide - 1);
+    *max_y = Clamp((area.y + area.h - 1) / layout->tile_height, 0, layout->tiles_high - 1);
+}
+
+// Sorts the group, bins every sprite into the screen tiles it overlaps and then
+// renders each tile as its own job. Tiles never overlap so the jobs can write
+// to the buffer without any synchronisation.
+void RenderGroupToOutput(
+    struct RenderGroup*     group,
+    struct OffscreenBuffer* buffer,
+    struct JobQueue*        queue,
+    struct MemoryArena*     arena
+) {
+    // The game builds its palette in ARGB, everything drawn from it has to be in
+    // the format of the buffer.
+    if (buffer->format != PixelFormatARGB8888) {
+        struct Palette* palette = PushStruct(arena, struct Palette);
+
+        for (u32 i = 0; i < ArrayCount(palette->colours); i += 1) {
+            palette->colours[i] = ConvertColour(group->palette->colours[i], buffer->format);
+        }
+
+        group->palette = palette;
+    }
+
+    struct SortEntry* scratch = PushArray(arena, struct SortEntry, group->count);
+    struct SortEntry* sorted  = RadixSort(group->entries, scratch, group->count, queue, arena);
+
+    struct TileLayout layout;
+    struct Rect*      clips;
+
+    if (group->layouts) {
+        struct CachedTileLayout* cached = FindTileLayout(group->layouts, buffer->width, buffer->height, CpuCoreCount(queue));
+
+        layout = cached->layout;
+        clips  = cached->clips;
+    } else {
+        layout = ComputeTileLayout(buffer->width, buffer->height, CpuCoreCount(queue));
+        clips  = PushArray(arena, struct Rect, layout.tiles_wide * layout.tiles_high);
+
+        ComputeTileClips(&layout, clips);
+    }
+
+    u32 tile_count = layout.tiles_wide * layout.tiles_high;
+
+    struct RenderTile* tiles = PushArray(arena, struct RenderTile, tile_count);
+
+    for (u32 i = 0; i < tile_count; i += 1) {
+        struct RenderTile* tile = &tiles[i];
+
+        tile->clip           = clips[i];
+        tile->bin_count      = 0;
+        tile->lit_count      = 0;
+        tile->fragment_count = 0;
+    }
+
+    // Binning is done in two passes over the sorted list, one to size the bins
+    // and one to fill them, so each bin is a tight slice of a single array.
+    struct Rect screen       = { 0, 0, layout.width, layout.height };
+    u32         binned_count = 0;
+
+    for (u32 i = 0; i < group->count; i += 1) {
+        struct Sprite* sprite = &group->sprites[sorted[i].index];
+        struct Rect    visible;
+
+        if (IntersectRect(screen, (struct Rect){ sprite->x, sprite->y, sprite->w, sprite->h }, &visible)) {
+            i32 min_x, min_y, max_x, max_y;
+            TileRange(&layout, visible, &min_x, &min_y, &max_x, &max_y);
+
+            for (i32 y = min_y; y <= max_y; y += 1) {
+                for (i32 x = min_x; x <= max_x; x += 1) {
+                    tiles[x + y * layout.tiles_wide].bin_count += 1;
+                    binned_count += 1;
+                }
+            }
+        }
+    }
+
+    u32* bins = PushArray(arena, u32, binned_count);
+
+    for (u32 i = 0; i < tile_count; i += 1) {
+        tiles[i].bin       = bins;
+        bins              += tiles[i].bin_count;
+        tiles[i].bin_count = 0;
+    }
+
+    for (u32 i = 0; i < group->count; i += 1) {
+        u32            index  = sorted[i].index;
+        struct Sprite* sprite = &group->sprites[index];
+        bool           is_lit = SortKeyLayer(sorted[i].key) < LayerEffects;
+        struct Rect    visible;
+
+        if (IntersectRect(screen, (struct Rect){ sprite->x, sprite->y, sprite->w, sprite->h }, &visible)) {
+            i32 min_x, min_y, max_x, max_y;
+            TileRange(&layout, visible, &min_x, &min_y, &max_x, &max_y);
+
+            for (i32 y = min_y; y <= max_y; y += 1) {
+                for (i32 x = min_x; x <= max_x; x += 1) {
+                    struct RenderTile* tile = &tiles[x + y * layout.tiles_wide];
+                    tile->bin[tile->bin_count++] = index;
+                    tile->lit_count += is_lit;
+                }
+            }
+        }
+    }
+
+    if (group->particles) {
+        BinParticles(group->particles, &layout, tiles, buffer->format, queue, arena);
+    }
+
+    struct RenderTileJob* jobs = PushArray(arena, struct RenderTileJob, tile_count);
+
+    for (u32 i = 0; i < tile_count; i += 1) {
+        struct RenderTileJob* job = &jobs[i];
+
+        job->buffer = buffer;
+        job->group  = group;
+        job->tile   = &tiles[i];
+
+        PushJob(queue, job, ThreadRenderTile);
+    }
+
+    CompleteRemainingWork(queue);
+}
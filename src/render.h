@@ -0,0 +1,213 @@
+// ==============================================
+// Rendering
+// ==============================================
+
+#define ARGB(a, r, g, b) (((u32)(a) << 24) | ((u32)(r) << 16) | ((u32)(g) << 8) | ((u32)(b) << 0))
+
+struct Rect {
+    i32 x;
+    i32 y;
+    i32 w;
+    i32 h;
+};
+
+// How a kernel combines what it draws with what is already in the buffer.
+enum BlendMode {
+    BlendCopy,
+    BlendAlpha, // Source over, using the alpha of the source colour.
+    BlendAdd,   // Per channel with saturation.
+
+    BlendModeCount,
+};
+
+// Kernels are generated for every pixel format and blend mode, so their inner
+// loops never look at either. They are handed an area that has already been
+// clipped to the buffer.
+//
+// Fill colours are in the buffer's format. Blit sources are always ARGB and are
+// converted to the buffer's format as they are copied.
+typedef void (*FillKernel)(struct OffscreenBuffer* buffer, struct Rect area, u32 colour);
+typedef void (*BlitKernel)(struct OffscreenBuffer* buffer, struct Rect area, u32* source, i32 source_pitch);
+typedef u32  (*ColourConverter)(u32 colour);
+
+// Lighting needs this and is included before render.c.
+u32 ConvertColour(u32 colour, enum PixelFormat format);
+
+// Layers are drawn back to front in the order they are declared.
+enum RenderLayer {
+    LayerFloor,
+    LayerItems,
+    LayerActors,
+    LayerEffects,
+    LayerUI,
+};
+
+// Sort keys are compared as plain integers, so the most significant field decides
+// the draw order first. Y-depth is biased so that sprites above the top of the
+// screen still sort before the ones below them.
+//
+//  63     56 55          32 31     16 15      0
+// +---------+--------------+---------+---------+
+// |  layer  |   y-depth    |  atlas  | material|
+// +---------+--------------+---------+---------+
+#define SORT_DEPTH_BIAS (1 << 23)
+#define SORT_DEPTH_MAX  ((1 << 24) - 1)
+
+#define SortKey(layer, depth, atlas, material) (                                       \
+    ((u64)((layer)                                              & 0xFF)   << 56) |     \
+    ((u64)(Clamp((i64)(depth) + SORT_DEPTH_BIAS, 0, SORT_DEPTH_MAX))      << 32) |     \
+    ((u64)((atlas)                                              & 0xFFFF) << 16) |     \
+    ((u64)((material)                                           & 0xFFFF) << 0)        \
+)
+
+#define SortKeyLayer(key) ((u32)((key) >> 56))
+
+// An 8 bit render target, each pixel is an index into a palette. Filling it
+// moves a quarter of the memory that filling an OffscreenBuffer does.
+struct IndexedBuffer {
+    u8* pixels;
+    i32 pitch;
+    i32 width;
+    i32 height;
+};
+
+enum SpriteKind {
+    SpriteRect,
+    SpriteLine,
+    SpriteCircle,
+    SpritePolygon,
+    SpriteImage,
+};
+
+// Images are palette indices like the indexed buffer. Two indices at the top of
+// the palette are reserved: one is never drawn and the other is replaced by the
+// sprite's colour, so the same frames can be drawn in different colours.
+#define ATLAS_TRANSPARENT 255
+#define ATLAS_BODY        254
+
+struct SpriteAtlas {
+           u8*             pixels;
+           i32             pitch;
+           i32             width;
+           i32             height;
+
+    // Bumped by whoever owns the atlas each time they change the pixels.
+           u32             version;
+
+    // A full colour copy for the geometry backend, rebuilt when the atlas or
+    // the palette changes. The left half is everything but the body and the
+    // right half is the body in white, so it can be tinted by vertex colour.
+    struct GeometryTexture texture;
+           u32             texture_atlas_version;
+           u32             texture_palette[256];
+};
+
+enum SpriteFlags {
+    SpriteAntiAliased = 1 << 0, // Lines only, and only after the lit layers.
+    SpriteFilled      = 1 << 1, // Circles only, otherwise just the outline.
+};
+
+struct Vertex {
+    f32 x;
+    f32 y;
+};
+
+// Every sprite carries its bounds so it can be binned the same way, a rect is
+// nothing but its bounds.
+struct Sprite {
+    i32 x;
+    i32 y;
+    i32 w;
+    i32 h;
+    u8  colour; // Index into the group's palette.
+    u8  kind;
+    u8  flags;
+
+    union {
+        struct { i32 x0, y0, x1, y1; }                  line;
+        struct { i32 x, y, radius; }                    circle;
+        struct { struct Vertex* vertices; u32 count; }  polygon;
+        struct { struct SpriteAtlas* atlas; i32 x, y; } image;
+    } shape;
+};
+
+struct SortEntry {
+    u64 key;
+    u32 index;
+    u32 padding;
+};
+
+// Everything the game wants drawn this frame. Sprites are pushed in any order and
+// sorted by key when the group is rendered, sprites with equal keys keep the order
+// they were pushed in.
+struct RenderGroup {
+    struct MemoryArena*     arena; // Holds polygon vertices until the group is drawn.
+    struct Sprite*          sprites;
+    struct SortEntry*       entries;
+           u32              count;
+           u32              capacity;
+           u8               clear_colour;
+    struct Palette*         palette;
+
+    // Optional, applied to everything below LayerEffects.
+    struct LightingPass*    lighting;
+
+    // Optional, when set everything below LayerEffects is drawn as palette
+    // indices and only expanded to full colour just before lighting.
+    struct IndexedBuffer*   indexed;
+
+    // Optional, drawn at the start of LayerEffects.
+    struct ParticlePass*    particles;
+
+    // Optional, the pre-rendered floor that everything else is drawn on top of.
+    // The screen is cleared to `clear_colour` when there isn't one.
+    struct StaticLayerPass* static_layer;
+
+    // Optional, layouts are worked out from scratch every frame without it.
+    struct TileLayoutCache* layouts;
+};
+
+// How the screen is split into tiles. The last row and column of tiles also
+// take whatever pixels are left over.
+struct TileLayout {
+    i32 width;
+    i32 height;
+    i32 tile_width;
+    i32 tile_height;
+    i32 tiles_wide;
+    i32 tiles_high;
+};
+
+// The job queue only holds 256 entries, so the tiles per side are capped to fit
+// whatever the buffer's size.
+#define MAX_TILES_PER_SIDE 15
+#define MAX_RENDER_TILES   (MAX_TILES_PER_SIDE * MAX_TILES_PER_SIDE)
+
+// A few layouts are kept, with the clip of every tile already worked out, so
+// switching back and forth between sizes while the window is dragged about
+// doesn't redo them.
+#define TILE_LAYOUT_CACHE_SIZE 4
+
+struct CachedTileLayout {
+           u32        cpu_core_count;
+    struct TileLayout layout;
+    struct Rect       clips[MAX_RENDER_TILES];
+};
+
+struct TileLayoutCache {
+    struct CachedTileLayout entries[TILE_LAYOUT_CACHE_SIZE];
+           u32              count;
+           u32              next; // The entry replaced next, oldest first.
+};
+
+// The screen is split into one tile per job. Each tile gets a bin holding the
+// indices of the sprites that touch it, in draw order. The first `lit_count`
+// of them are drawn before the lighting is applied.
+struct RenderTile {
+    struct Rect              clip;
+           u32*              bin;
+           u32               bin_count;
+           u32               lit_count;
+    struct ParticleFragment* fragments;
+           u32               fragment_count;
+};
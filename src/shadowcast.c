@@ -0,0 +1,98 @@
+// ==============================================
+// Shadowcasting
+// ==============================================
+
+// Called once for every tile that can be seen from the origin, tiles on the
+// boundary between two octants may be visited twice.
+typedef void (*ShadowcastFn)(void* data, i32 x, i32 y);
+
+struct Shadowcast {
+    struct TileMap*     map;
+           i32          origin_x;
+           i32          origin_y;
+           i32          radius;
+           ShadowcastFn visit;
+           void*        data;
+};
+
+// Maps the (column, row) of the octant being scanned onto map coordinates.
+static i32 octant_transforms[8][4] = {
+    {  1,  0,  0,  1 },
+    {  0,  1,  1,  0 },
+    {  0, -1,  1,  0 },
+    { -1,  0,  0,  1 },
+    { -1,  0,  0, -1 },
+    {  0, -1, -1,  0 },
+    {  0,  1, -1,  0 },
+    {  1,  0,  0, -1 },
+};
+
+// Recursive shadowcasting: scan each row of the octant outwards between a pair of
+// slopes. When a run of blocking tiles starts, the visible part past it is scanned
+// recursively and the current scan continues from the far side of the run.
+void CastOctant(struct Shadowcast* cast, i32 row, f32 start_slope, f32 end_slope, i32* transform) {
+    if (start_slope < end_slope) return;
+
+    i32 radius_squared = cast->radius * cast->radius;
+    f32 next_start     = start_slope;
+
+    for (i32 distance = row; distance <= cast->radius; distance += 1) {
+        bool blocked = false;
+        i32  dy      = -distance;
+
+        for (i32 dx = -distance; dx <= 0; dx += 1) {
+            f32 left_slope  = (dx - 0.5f) / (dy + 0.5f);
+            f32 right_slope = (dx + 0.5f) / (dy - 0.5f);
+
+            if (start_slope < right_slope) continue;
+            if (end_slope   > left_slope)  break;
+
+            i32 x = cast->origin_x + dx * transform[0] + dy * transform[1];
+            i32 y = cast->origin_y + dx * transform[2] + dy * transform[3];
+
+            if (dx * dx + dy * dy <= radius_squared && IsInMap(cast->map, x, y)) {
+                cast->visit(cast->data, x, y);
+            }
+
+            bool is_opaque = TileBlocksLight(cast->map, x, y);
+
+            if (blocked) {
+                if (is_opaque) {
+                    next_start = right_slope;
+                } else {
+                    blocked     = false;
+                    start_slope = next_start;
+                }
+            } else if (is_opaque && distance < cast->radius) {
+                blocked = true;
+                CastOctant(cast, distance + 1, start_slope, left_slope, transform);
+                next_start = right_slope;
+            }
+        }
+
+        if (blocked) break;
+    }
+}
+
+void CastShadows(
+    struct TileMap* map,
+    i32 origin_x, i32 origin_y, i32 radius,
+    ShadowcastFn visit, void* data
+) {
+    struct Shadowcast cast = {
+        .map      = map,
+        .origin_x = origin_x,
+        .origin_y = origin_y,
+        .radius   = radius,
+        .visit    = visit,
+        .data     = data,
+    };
+
+    if (IsInMap(map, origin_x, origin_y)) {
+        visit(data, origin_x, origin_y);
+
+        for (u32 octant = 0; octant < 8; octant += 1) {
+            CastOctant(&cast, 1, 1.0f, 0.0f, octant_transforms[octant]);
+        }
+    }
+}
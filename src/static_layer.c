@@ -0,0 +1,179 @@
+// ==============================================
+// Static Layer
+// ==============================================
+
+u8* StaticChunkPixels(struct StaticLayer* layer, u32 chunk_x, u32 chunk_y) {
+    u32 chunk = chunk_x + chunk_y * layer->chunks_wide;
+    return(layer->pixels + chunk * STATIC_CHUNK_SIZE_PIXELS * STATIC_CHUNK_SIZE_PIXELS);
+}
+
+void InitStaticLayer(struct StaticLayer* layer, struct TileMap* tile_map, struct MemoryArena* arena) {
+    layer->chunks_wide = (tile_map->width  + STATIC_CHUNK_SIZE_TILES - 1) / STATIC_CHUNK_SIZE_TILES;
+    layer->chunks_high = (tile_map->height + STATIC_CHUNK_SIZE_TILES - 1) / STATIC_CHUNK_SIZE_TILES;
+
+    u32 chunk_count = layer->chunks_wide * layer->chunks_high;
+
+    layer->pixels      = PushArray(arena, u8,   chunk_count * STATIC_CHUNK_SIZE_PIXELS * STATIC_CHUNK_SIZE_PIXELS);
+    layer->dirty       = PushArray(arena, bool, chunk_count);
+    layer->drawn_tiles = PushArray(arena, u8,   tile_map->width * tile_map->height);
+
+    for (u32 i = 0; i < chunk_count; i += 1) {
+        layer->dirty[i] = true;
+    }
+
+    for (u32 i = 0; i < tile_map->width * tile_map->height; i += 1) {
+        layer->drawn_tiles[i] = (u8)tile_map->tiles[i];
+    }
+
+    layer->tile_map_version = tile_map->version;
+}
+
+// ==============================================
+// Drawing the chunks
+
+struct StaticChunkJob {
+    struct StaticLayer* layer;
+    struct TileMap*     tile_map;
+           u32          chunk_x;
+           u32          chunk_y;
+};
+
+void ThreadDrawStaticChunk(void* data) {
+    struct StaticChunkJob* job      = (struct StaticChunkJob*)data;
+    struct StaticLayer*    layer    = job->layer;
+    struct TileMap*        tile_map = job->tile_map;
+
+    u8* pixels = StaticChunkPixels(layer, job->chunk_x, job->chunk_y);
+
+    for (u32 tile_y = 0; tile_y < STATIC_CHUNK_SIZE_TILES; tile_y += 1) {
+        for (u32 tile_x = 0; tile_x < STATIC_CHUNK_SIZE_TILES; tile_x += 1) {
+            i32 map_x = job->chunk_x * STATIC_CHUNK_SIZE_TILES + tile_x;
+            i32 map_y = job->chunk_y * STATIC_CHUNK_SIZE_TILES + tile_y;
+
+            // Chunks on the edge can hang off the map, that part is never shown.
+            u8 colour = IsInMap(tile_map, map_x, map_y)
+                      ? tile_infos[GetTile(tile_map, map_x, map_y)].colour
+                      : ColourBlack;
+
+            u8* row = pixels
+                    + tile_x * TILE_SIZE_PIXELS
+                    + tile_y * TILE_SIZE_PIXELS * STATIC_CHUNK_SIZE_PIXELS;
+
+            for (u32 y = 0; y < TILE_SIZE_PIXELS; y += 1) {
+                memset(row, colour, TILE_SIZE_PIXELS);
+                row += STATIC_CHUNK_SIZE_PIXELS;
+            }
+        }
+    }
+}
+
+// Finds which chunks the tile changes since the last update landed in and
+// redraws just those, one job per chunk.
+void UpdateStaticLayer(struct StaticLayer* layer, struct TileMap* tile_map, struct JobQueue* queue, struct MemoryArena* arena) {
+    if (layer->tile_map_version != tile_map->version) {
+        for (u32 y = 0; y < tile_map->height; y += 1) {
+            for (u32 x = 0; x < tile_map->width; x += 1) {
+                u32 index = x + y * tile_map->width;
+
+                if (layer->drawn_tiles[index] != (u8)tile_map->tiles[index]) {
+                    layer->drawn_tiles[index] = (u8)tile_map->tiles[index];
+
+                    u32 chunk_x = x / STATIC_CHUNK_SIZE_TILES;
+                    u32 chunk_y = y / STATIC_CHUNK_SIZE_TILES;
+                    layer->dirty[chunk_x + chunk_y * layer->chunks_wide] = true;
+                }
+            }
+        }
+
+        layer->tile_map_version = tile_map->version;
+    }
+
+    u32 chunk_count = layer->chunks_wide * layer->chunks_high;
+    u32 job_count   = 0;
+
+    struct StaticChunkJob* jobs = PushArray(arena, struct StaticChunkJob, chunk_count);
+
+    for (u32 i = 0; i < chunk_count; i += 1) {
+        if (layer->dirty[i]) {
+            struct StaticChunkJob* job = &jobs[job_count++];
+
+            job->layer    = layer;
+            job->tile_map = tile_map;
+            job->chunk_x  = i % layer->chunks_wide;
+            job->chunk_y  = i / layer->chunks_wide;
+
+            layer->dirty[i] = false;
+
+            PushJob(queue, job, ThreadDrawStaticChunk);
+
+            // The queue only has room for so many jobs at once.
+            if (job_count % 128 == 0) {
+                CompleteRemainingWork(queue);
+            }
+        }
+    }
+
+    CompleteRemainingWork(queue);
+}
+
+// ==============================================
+// Rendering
+
+// Copies the part of the layer under the clip rectangle into the group's
+// indexed buffer, or expands it through the palette when there isn't one.
+// Anything the map doesn't cover is cleared.
+void DrawStaticLayer(struct RenderGroup* group, struct OffscreenBuffer* buffer, struct Rect clip) {
+    struct StaticLayerPass* pass  = group->static_layer;
+    struct StaticLayer*     layer = pass->layer;
+
+    struct Rect layer_area = {
+        -pass->camera_x,
+        -pass->camera_y,
+        layer->chunks_wide * STATIC_CHUNK_SIZE_PIXELS,
+        layer->chunks_high * STATIC_CHUNK_SIZE_PIXELS,
+    };
+
+    struct Rect area;
+    bool        is_visible = IntersectRect(clip, layer_area, &area);
+
+    if (!is_visible || area.w != clip.w || area.h != clip.h) {
+        if (group->indexed) {
+            DrawRectIndexed(group->indexed, clip, clip.x, clip.y, clip.w, clip.h, group->clear_colour);
+        } else {
+            DrawRect(buffer, clip, clip.x, clip.y, clip.w, clip.h, group->palette->colours[group->clear_colour]);
+        }
+    }
+
+    if (is_visible) {
+        u32* colours = group->palette->colours;
+
+        for (i32 y = area.y; y < area.y + area.h; y += 1) {
+            i32 layer_y = y + pass->camera_y;
+            i32 chunk_y = layer_y / STATIC_CHUNK_SIZE_PIXELS;
+            i32 inner_y = layer_y % STATIC_CHUNK_SIZE_PIXELS;
+            i32 x       = area.x;
+
+            // Each row is copied in runs, one for each chunk it crosses.
+            while (x < area.x + area.w) {
+                i32 layer_x = x + pass->camera_x;
+                i32 chunk_x = layer_x / STATIC_CHUNK_SIZE_PIXELS;
+                i32 inner_x = layer_x % STATIC_CHUNK_SIZE_PIXELS;
+                i32 run     = Min(STATIC_CHUNK_SIZE_PIXELS - inner_x, area.x + area.w - x);
+
+                u8* from = StaticChunkPixels(layer, chunk_x, chunk_y) + inner_x + inner_y * STATIC_CHUNK_SIZE_PIXELS;
+
+                if (group->indexed) {
+                    memcpy(group->indexed->pixels + x + y * group->indexed->pitch, from, run);
+                } else {
+                    u32* to = (u32*)((u8*)buffer->pixels + y * buffer->pitch) + x;
+
+                    for (i32 i = 0; i < run; i += 1) {
+                        to[i] = colours[from[i]];
+                    }
+                }
+
+                x += run;
+            }
+        }
+    }
+}
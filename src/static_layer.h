@@ -0,0 +1,33 @@
+// ==============================================
+// Static Layer
+// ==============================================
+
+#define STATIC_CHUNK_SIZE_PIXELS 256
+#define STATIC_CHUNK_SIZE_TILES  (STATIC_CHUNK_SIZE_PIXELS / TILE_SIZE_PIXELS)
+
+// The floor of the whole map pre-rendered as palette indices, in square chunks.
+// Chunks are only redrawn when one of their tiles changes, so scrolling just
+// copies rows out of the chunks instead of drawing every tile again. Storing
+// indices rather than colours means the palette effects still apply.
+struct StaticLayer {
+           u32   chunks_wide;
+           u32   chunks_high;
+           u8*   pixels;
+           bool* dirty;
+
+    // What each tile was when its chunk was last drawn, compared against the
+    // map to find out which chunks a change touched.
+           u8*   drawn_tiles;
+           u32   tile_map_version;
+};
+
+// Handed to the renderer, replaces clearing the bottom of LayerFloor.
+struct StaticLayerPass {
+    struct StaticLayer* layer;
+           i32          camera_x;
+           i32          camera_y;
+};
+
+// The renderer calls this for each screen tile, static_layer.c is included
+// after render.c because it needs the rectangle helpers.
+void DrawStaticLayer(struct RenderGroup* group, struct OffscreenBuffer* buffer, struct Rect clip);
@@ -0,0 +1,206 @@
+// ==============================================
+// Synth
+// ==============================================
+
+void InitSynth(struct Synth* synth, u32 samples_per_second) {
+    memset(synth, 0, sizeof(*synth));
+
+    synth->samples_per_second = samples_per_second;
+
+    for (u32 i = 0; i < WAVETABLE_SIZE; i += 1) {
+        f32 t = (f32)i / (f32)WAVETABLE_SIZE;
+
+        synth->wavetables[WaveformSine]    [i] = sinf(2.0f * PI * t);
+        synth->wavetables[WaveformSquare]  [i] = (t < 0.5f) ? 1.0f : -1.0f;
+        synth->wavetables[WaveformTriangle][i] = (t < 0.25f) ? 4.0f * t
+                                               : (t < 0.75f) ? 2.0f - 4.0f * t
+                                               :               4.0f * t - 4.0f;
+        synth->wavetables[WaveformSaw]     [i] = 2.0f * t - 1.0f;
+    }
+
+    for (u32 waveform = 0; waveform < WaveformCount; waveform += 1) {
+        synth->wavetables[waveform][WAVETABLE_SIZE] = synth->wavetables[waveform][0];
+    }
+}
+
+// ==============================================
+// Tones
+
+// How much the envelope moves each frame to cover `amount` in `seconds`. Zero
+// seconds gets there in a single frame.
+f32 EnvelopeRate(struct Synth* synth, f32 amount, f32 seconds) {
+    return(amount / Max(seconds * (f32)synth->samples_per_second, 1.0f));
+}
+
+// Phase steps are fractions of a cycle per frame, in 0.32 fixed point.
+f64 PhaseStep(struct Synth* synth, f32 frequency) {
+    return((f64)frequency / (f64)synth->samples_per_second * 4294967296.0);
+}
+
+// Returns 0 when every tone is already playing.
+ToneId PlayTone(struct Synth* synth, struct ToneParams* params) {
+    ToneId id = 0;
+
+    for (u32 i = 0; i < MAX_TONES && id == 0; i += 1) {
+        if (synth->stage[i] == EnvelopeOff) {
+            struct Envelope* envelope   = &params->envelope;
+                   u32       generation = (synth->generation[i] + 1) & ((1 << (32 - TONE_INDEX_BITS)) - 1);
+                   f32       hold       = params->hold_seconds * (f32)synth->samples_per_second;
+
+            synth->phase        [i] = 0;
+            synth->step         [i] = (u32)Clamp(PhaseStep(synth, params->frequency), 0.0, 4294967295.0);
+            synth->step_slide   [i] = (i32)(PhaseStep(synth, params->slide) / (f64)synth->samples_per_second);
+            synth->waveform     [i] = (u8)params->waveform;
+            synth->stage        [i] = EnvelopeAttack;
+            synth->level        [i] = 0.0f;
+            synth->attack_rate  [i] = EnvelopeRate(synth, 1.0f,                    envelope->attack);
+            synth->decay_rate   [i] = EnvelopeRate(synth, 1.0f - envelope->sustain, envelope->decay);
+            synth->sustain_level[i] = envelope->sustain;
+            synth->release_rate [i] = EnvelopeRate(synth, 1.0f,                    envelope->release);
+            synth->hold_frames  [i] = (params->hold_seconds > 0.0f) ? (u32)Max(hold, 1.0f) : HOLD_UNTIL_RELEASED;
+            synth->generation   [i] = Max(generation, 1);
+
+            // The tables run from -1 to 1, the mix is in 16 bit units.
+            ConstantPowerPan(params->volume * 32767.0f, params->pan, &synth->gain_left[i], &synth->gain_right[i]);
+
+            id = (synth->generation[i] << TONE_INDEX_BITS) | i;
+        }
+    }
+
+    return(id);
+}
+
+// Returns the tone's index, or -1 once it has finished or been reused.
+i32 FindTone(struct Synth* synth, ToneId id) {
+    u32 index = id & (MAX_TONES - 1);
+    bool is_current = synth->stage[index] != EnvelopeOff && synth->generation[index] == (id >> TONE_INDEX_BITS);
+
+    return(is_current ? (i32)index : -1);
+}
+
+void ReleaseTone(struct Synth* synth, ToneId id) {
+    i32 index = FindTone(synth, id);
+
+    if (index >= 0 && synth->stage[index] != EnvelopeRelease) {
+        synth->stage[index] = EnvelopeRelease;
+    }
+}
+
+void SetToneFrequency(struct Synth* synth, ToneId id, f32 frequency) {
+    i32 index = FindTone(synth, id);
+
+    if (index >= 0) {
+        synth->step[index] = (u32)Clamp(PhaseStep(synth, frequency), 0.0, 4294967295.0);
+    }
+}
+
+// ==============================================
+// Rendering
+
+// Renders one tone into the interleaved stereo accumulator, four frames at a
+// time. Only the table lookups are scalar. The envelope is a straight line
+// across each group of four, so stages change on group boundaries, about
+// every 80 microseconds.
+void RenderTone(struct Synth* synth, u32 tone, f32* out, u32 frame_count) {
+    f32* table   = synth->wavetables[synth->waveform[tone]];
+    u32  phase   = synth->phase[tone];
+    u32  step    = synth->step[tone];
+    i32  slide   = synth->step_slide[tone];
+    u32  stage   = synth->stage[tone];
+    f32  level   = synth->level[tone];
+    f32  sustain = synth->sustain_level[tone];
+    u32  hold    = synth->hold_frames[tone];
+
+    u32 fraction_bits = 32 - WAVETABLE_BITS;
+    u32 fraction_mask = (1 << fraction_bits) - 1;
+
+    __m128 to_fraction  = _mm_set1_ps(1.0f / (f32)(1 << fraction_bits));
+    __m128 lane_offsets = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+    __m128 gains        = _mm_setr_ps(synth->gain_left[tone], synth->gain_right[tone], synth->gain_left[tone], synth->gain_right[tone]);
+
+    for (u32 i = 0; i < frame_count && stage != EnvelopeOff; i += 4) {
+        u32 lanes = Min(4, frame_count - i);
+
+        f32 slope = (stage == EnvelopeAttack)  ?  synth->attack_rate [tone]
+                  : (stage == EnvelopeDecay)   ? -synth->decay_rate  [tone]
+                  : (stage == EnvelopeRelease) ? -synth->release_rate[tone]
+                  :                               0.0f;
+
+        __m128 levels = _mm_add_ps(_mm_set1_ps(level), _mm_mul_ps(_mm_set1_ps(slope), lane_offsets));
+        levels = _mm_min_ps(levels, _mm_set1_ps(1.0f));
+        levels = _mm_max_ps(levels, _mm_set1_ps(stage == EnvelopeDecay ? sustain : 0.0f));
+
+        level += slope * (f32)lanes;
+
+        if (stage == EnvelopeAttack && level >= 1.0f) {
+            level = 1.0f;
+            stage = EnvelopeDecay;
+        } else if (stage == EnvelopeDecay && level <= sustain) {
+            // Nothing to sustain means a one-shot, which ends here.
+            level = sustain;
+            stage = (sustain > 0.0f) ? EnvelopeSustain : EnvelopeOff;
+        } else if (stage == EnvelopeRelease && level <= 0.0f) {
+            level = 0.0f;
+            stage = EnvelopeOff;
+        }
+
+        if (hold != HOLD_UNTIL_RELEASED && stage != EnvelopeRelease && stage != EnvelopeOff) {
+            hold  = (hold > lanes) ? hold - lanes : 0;
+            stage = (hold == 0) ? EnvelopeRelease : stage;
+        }
+
+        u32 phases[4] = { phase, phase + step, phase + step * 2, phase + step * 3 };
+
+        __m128 from = _mm_setr_ps(
+            table[phases[0] >> fraction_bits],
+            table[phases[1] >> fraction_bits],
+            table[phases[2] >> fraction_bits],
+            table[phases[3] >> fraction_bits]
+        );
+        __m128 to = _mm_setr_ps(
+            table[(phases[0] >> fraction_bits) + 1],
+            table[(phases[1] >> fraction_bits) + 1],
+            table[(phases[2] >> fraction_bits) + 1],
+            table[(phases[3] >> fraction_bits) + 1]
+        );
+        __m128 t = _mm_mul_ps(_mm_cvtepi32_ps(_mm_setr_epi32(
+            phases[0] & fraction_mask,
+            phases[1] & fraction_mask,
+            phases[2] & fraction_mask,
+            phases[3] & fraction_mask
+        )), to_fraction);
+
+        __m128 samples = _mm_mul_ps(_mm_add_ps(from, _mm_mul_ps(_mm_sub_ps(to, from), t)), levels);
+        __m128 first   = _mm_unpacklo_ps(samples, samples);
+        __m128 second  = _mm_unpackhi_ps(samples, samples);
+
+        if (lanes == 4) {
+            Accumulate4(out + i * 2, first, second, gains);
+        } else {
+            f32 frames[8];
+            _mm_storeu_ps(frames + 0, _mm_mul_ps(first,  gains));
+            _mm_storeu_ps(frames + 4, _mm_mul_ps(second, gains));
+
+            for (u32 j = 0; j < lanes * 2; j += 1) {
+                out[i * 2 + j] += frames[j];
+            }
+        }
+
+        phase += step * lanes;
+        step   = (u32)Clamp((i64)step + (i64)slide * lanes, 0, 0xFFFFFFFF);
+    }
+
+    synth->phase      [tone] = phase;
+    synth->step       [tone] = step;
+    synth->stage      [tone] = (u8)stage;
+    synth->level      [tone] = level;
+    synth->hold_frames[tone] = hold;
+}
+
+void RenderSynth(struct Synth* synth, f32* out, u32 frame_count) {
+    for (u32 tone = 0; tone < MAX_TONES; tone += 1) {
+        if (synth->stage[tone] != EnvelopeOff) {
+            RenderTone(synth, tone, out, frame_count);
+        }
+    }
+}
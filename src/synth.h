@@ -0,0 +1,82 @@
+// ==============================================
+// Synth
+// ==============================================
+
+#define MAX_TONES 64
+
+// Each wavetable is one cycle, looked up by the top bits of a 32 bit phase that
+// wraps by itself, so a tone never drifts however long it plays.
+#define WAVETABLE_BITS 10
+#define WAVETABLE_SIZE (1 << WAVETABLE_BITS)
+
+enum Waveform {
+    WaveformSine,
+    WaveformSquare,
+    WaveformTriangle,
+    WaveformSaw,
+
+    WaveformCount,
+};
+
+enum EnvelopeStage {
+    EnvelopeOff,
+    EnvelopeAttack,
+    EnvelopeDecay,
+    EnvelopeSustain,
+    EnvelopeRelease,
+};
+
+// Times are in seconds, the sustain level is a fraction of the peak.
+struct Envelope {
+    f32 attack;
+    f32 decay;
+    f32 sustain;
+    f32 release;
+};
+
+struct ToneParams {
+           enum Waveform waveform;
+           f32           frequency;
+           f32           slide;        // Hz per second, for sweeps.
+           f32           volume;
+           f32           pan;          // -1 is hard left, 1 is hard right.
+    struct Envelope      envelope;
+           f32           hold_seconds; // Until the release starts, 0 holds until ReleaseTone.
+};
+
+// The index in the low bits and the generation above them, like a VoiceId.
+typedef u32 ToneId;
+
+#define TONE_INDEX_BITS 6
+
+// Hold frames for a tone that waits for ReleaseTone.
+#define HOLD_UNTIL_RELEASED 0xFFFFFFFF
+
+// Tones are kept as a structure of arrays, so rendering a block only touches
+// what it needs. Rates are per frame.
+struct Synth {
+    u32 samples_per_second;
+
+    // One entry past the end of each table holds a copy of the first, so the
+    // blend between entries never has to wrap.
+    f32 wavetables[WaveformCount][WAVETABLE_SIZE + 1];
+
+    u32 phase        [MAX_TONES];
+    u32 step         [MAX_TONES];
+    i32 step_slide   [MAX_TONES];
+    u8  waveform     [MAX_TONES];
+    u8  stage        [MAX_TONES];
+    f32 level        [MAX_TONES];
+    f32 attack_rate  [MAX_TONES];
+    f32 decay_rate   [MAX_TONES];
+    f32 sustain_level[MAX_TONES];
+    f32 release_rate [MAX_TONES];
+    u32 hold_frames  [MAX_TONES];
+    f32 gain_left    [MAX_TONES];
+    f32 gain_right   [MAX_TONES];
+    u32 generation   [MAX_TONES];
+};
+
+// The mixer renders the synth along with its voices, but audio.c comes first
+// in the build.
+void RenderSynth(struct Synth* synth, f32* out, u32 frame_count);
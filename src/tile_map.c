@@ -0,0 +1,166 @@
+// ==============================================
+// Tile Map
+// ==============================================
+
+static struct TileInfo tile_infos[TileTypeCount] = {
+    [OuterFenceVertical]     = { ColourFence,           0               },
+    [OuterFenceHorizontal]   = { ColourFence,           0               },
+    [OuterGatePost]          = { ColourGatePost,        TileBlocksSight },
+    [BalconyVertical]        = { ColourBalcony,         0               },
+    [BalconyHorizontal]      = { ColourBalcony,         0               },
+    [StairsUp]               = { ColourStairsUp,        0               },
+    [StairsDown]             = { ColourStairsDown,      0               },
+    [RunningTrackVertical]   = { ColourRunningTrack,    0               },
+    [RunningTrackHorizontal] = { ColourRunningTrack,    0               },
+    [RunningTrackCurveA]     = { ColourRunningTrack,    0               },
+    [HallwayFloor]           = { ColourHallway,         0               },
+    [ClassRoomFloor]         = { ColourClassRoom,       0               },
+    [LibraryFloor]           = { ColourLibrary,         0               },
+    [DirtFloor]              = { ColourDirt,            0               },
+    [GrassFloor]             = { ColourGrass,           0               },
+    [PentagramTL]            = { ColourPentagramEdge,   0               },
+    [PentagramTM]            = { ColourPentagramLine,   0               },
+    [PentagramTR]            = { ColourPentagramEdge,   0               },
+    [PentagramML]            = { ColourPentagramLine,   0               },
+    [PentagramMM]            = { ColourPentagramCentre, 0               },
+    [PentagramMR]            = { ColourPentagramLine,   0               },
+    [PentagramBL]            = { ColourPentagramEdge,   0               },
+    [PentagramBM]            = { ColourPentagramLine,   0               },
+    [PentagramBR]            = { ColourPentagramEdge,   0               },
+    [StreetFloor0]           = { ColourStreet,          0               },
+    [StreetFloor1]           = { ColourStreetLine,      0               },
+    [Wall]                   = { ColourWall,            TileBlocksSight },
+};
+
+bool IsInMap(struct TileMap* map, i32 x, i32 y) {
+    return(x >= 0 && y >= 0 && x < (i32)map->width && y < (i32)map->height);
+}
+
+enum TileType GetTile(struct TileMap* map, i32 x, i32 y) {
+    Assert(IsInMap(map, x, y));
+    return(map->tiles[x + y * map->width]);
+}
+
+// Anything outside of the map blocks sight, so nothing leaks off the edges.
+bool TileBlocksLight(struct TileMap* map, i32 x, i32 y) {
+    return(!IsInMap(map, x, y) || (tile_infos[GetTile(map, x, y)].flags & TileBlocksSight));
+}
+
+void SetTile(struct TileMap* map, i32 x, i32 y, enum TileType type) {
+    Assert(IsInMap(map, x, y));
+
+    enum TileType* tile = &map->tiles[x + y * map->width];
+
+    if (*tile != type) {
+        bool was_blocking = tile_infos[*tile].flags & TileBlocksSight;
+        bool is_blocking  = tile_infos[ type].flags & TileBlocksSight;
+
+        if (was_blocking != is_blocking) {
+            struct TileChange* change = &map->blocking_changes[map->blocking_change_count & (TILE_CHANGE_LOG_SIZE - 1)];
+
+            change->x = x;
+            change->y = y;
+            map->blocking_change_count += 1;
+        }
+
+        struct TileChange* change = &map->changes[map->change_count & (TILE_CHANGE_LOG_SIZE - 1)];
+
+        change->x = x;
+        change->y = y;
+        map->change_count += 1;
+
+        *tile         = type;
+        map->version += 1;
+    }
+}
+
+void FillTiles(struct TileMap* map, i32 x, i32 y, i32 w, i32 h, enum TileType type) {
+    for (i32 row = y; row < y + h; row += 1) {
+        for (i32 col = x; col < x + w; col += 1) {
+            SetTile(map, col, row, type);
+        }
+    }
+}
+
+void OutlineTiles(struct TileMap* map, i32 x, i32 y, i32 w, i32 h, enum TileType horizontal, enum TileType vertical) {
+    FillTiles(map, x,         y,         w, 1, horizontal);
+    FillTiles(map, x,         y + h - 1, w, 1, horizontal);
+    FillTiles(map, x,         y + 1,     1, h - 2, vertical);
+    FillTiles(map, x + w - 1, y + 1,     1, h - 2, vertical);
+}
+
+// The school grounds are laid out by hand: the street and fence, the running
+// track, and a building of four classrooms.
+void GenerateSchool(struct TileMap* map, struct MemoryArena* arena) {
+    map->width   = 128;
+    map->height  = 80;
+    map->tiles   = PushArray(arena, enum TileType, map->width * map->height);
+    map->version = 0;
+
+    // Start from a known tile so the blocking change log sees real transitions.
+    for (u32 i = 0; i < map->width * map->height; i += 1) {
+        map->tiles[i] = GrassFloor;
+    }
+
+    i32 width  = map->width;
+    i32 height = map->height;
+
+    // Grounds, with the street running along the bottom.
+    FillTiles(map, 0, 0,          width, height - 5, GrassFloor);
+    FillTiles(map, 0, height - 5, width, 5,          StreetFloor0);
+    FillTiles(map, 0, height - 3, width, 1,          StreetFloor1);
+
+    for (i32 x = 1; x < width; x += 4) {
+        SetTile(map, x, height - 3, StreetFloor0);
+    }
+
+    // Fence and front gate.
+    OutlineTiles(map, 0, 0, width, height - 5, OuterFenceHorizontal, OuterFenceVertical);
+
+    i32 gate_x = 88;
+    FillTiles(map, gate_x - 1, height - 6, 5, 1, DirtFloor);
+    SetTile  (map, gate_x - 2, height - 6,       OuterGatePost);
+    SetTile  (map, gate_x + 4, height - 6,       OuterGatePost);
+    FillTiles(map, gate_x,     51,         3, height - 57, DirtFloor);
+
+    // Running track.
+    OutlineTiles(map, 8, 8, 40, 24, RunningTrackHorizontal, RunningTrackVertical);
+    SetTile(map, 8,  8,  RunningTrackCurveA);
+    SetTile(map, 47, 8,  RunningTrackCurveA);
+    SetTile(map, 8,  31, RunningTrackCurveA);
+    SetTile(map, 47, 31, RunningTrackCurveA);
+
+    // School building, split into four rooms by a pair of hallways.
+    FillTiles   (map, 60, 8,  60, 43, ClassRoomFloor);
+    OutlineTiles(map, 60, 8,  60, 43, Wall, Wall);
+    FillTiles   (map, 61, 27, 58, 5,  Wall);
+    FillTiles   (map, 87, 9,  5,  41, Wall);
+    FillTiles   (map, 61, 28, 58, 3,  HallwayFloor);
+    FillTiles   (map, 88, 9,  3,  42, HallwayFloor);
+    FillTiles   (map, 61, 32, 26, 18, LibraryFloor);
+
+    // Classroom doors.
+    FillTiles(map, 73,  27, 2, 1, ClassRoomFloor);
+    FillTiles(map, 104, 27, 2, 1, ClassRoomFloor);
+    FillTiles(map, 73,  31, 2, 1, LibraryFloor);
+    FillTiles(map, 104, 31, 2, 1, ClassRoomFloor);
+
+    SetTile(map, 61,  29, StairsUp);
+    SetTile(map, 118, 29, StairsDown);
+
+    FillTiles(map, 60, 7, 60, 1, BalconyHorizontal);
+
+    // Something has been drawn on the floor of the last classroom.
+    i32 pentagram_x = 104;
+    i32 pentagram_y = 40;
+
+    enum TileType pentagram[9] = {
+        PentagramTL, PentagramTM, PentagramTR,
+        PentagramML, PentagramMM, PentagramMR,
+        PentagramBL, PentagramBM, PentagramBR,
+    };
+
+    for (i32 i = 0; i < 9; i += 1) {
+        SetTile(map, pentagram_x - 1 + i % 3, pentagram_y - 1 + i / 3, pentagram[i]);
+    }
+}